@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "banded.h"
+#include "prepass.h"
+
+using namespace std;
+
+size_t memoryBudget = 0;
+
+extern RenderLayout renderLayout;
+void initDepthBuffer(int width, int height);
+
+// A recorded triangle: draws[draw].triangles, triangle number triangle
+struct BinEntry {
+    uint32_t draw, triangle;
+};
+
+static int width = 0, height = 0;
+static int bandHeight = 0;      // rows per band; 0 when banded rendering is off
+static RenderLayout bandLayout = LAYOUT_LINEAR;
+static std::vector<RecordedDraw> draws;
+static std::vector<std::vector<BinEntry>> bins;         // triangles per band, in draw order
+
+
+void resetBanded()
+{
+    memoryBudget = 0;
+    bandHeight = 0;
+    draws.clear();
+    bins.clear();
+}
+
+bool bandedActive()
+{
+    return bandHeight > 0;
+}
+
+// Largest band whose color and depth targets fit the budget
+void startBanded(int w, int h)
+{
+    width = w;
+    height = h;
+    // Color plus the widest depth format, plus a pre-pass's shade-equal flag bit
+    auto bytesFor = [](size_t texels) { return texels * (sizeof(pixel_t) + sizeof(float)) + (texels + 7) / 8; };
+    bandLayout = renderLayout;
+    size_t rowBytes = bytesFor(w);
+    if (bandLayout == LAYOUT_TILED)
+    {
+        // tiled targets pad rows to whole tiles, and bands to whole tile rows
+        rowBytes = bytesFor(layoutSize(LAYOUT_TILED, w, LAYOUT_TILE) / LAYOUT_TILE);
+        if (memoryBudget / rowBytes < LAYOUT_TILE)
+        {
+            bandLayout = LAYOUT_LINEAR;
+            rowBytes = bytesFor(w);
+        }
+    }
+    int rows = (int)std::min<size_t>(h, memoryBudget / std::max<size_t>(1, rowBytes));
+    if (bandLayout == LAYOUT_TILED && rows < h) rows -= rows % LAYOUT_TILE;
+    bandHeight = std::max(1, rows);
+    bins.assign((h + bandHeight - 1) / bandHeight, {});
+    draws.clear();
+    std::cout << "Banded rendering: " << bins.size() << " bands of " << bandHeight << " rows" << std::endl;
+}
+
+void recordBandedDraw(const std::vector<Vertex> &tris)
+{
+    uint32_t draw = (uint32_t)draws.size();
+    draws.push_back({tris, boundTexture});
+    for (size_t i = 0; i + 2 < tris.size(); i += 3)
+    {
+        BinEntry entry = {draw, (uint32_t)(i / 3)};
+
+        // Sample rows are the integers in [ceil(minY), ceil(maxY))
+        float minY = std::min({tris[i].position.y, tris[i + 1].position.y, tris[i + 2].position.y});
+        float maxY = std::max({tris[i].position.y, tris[i + 1].position.y, tris[i + 2].position.y});
+        if (!std::isfinite(minY) || !std::isfinite(maxY)) continue;
+        float first = std::max(std::ceil(minY), 0.0f);
+        float last = std::min(std::ceil(maxY) - 1, (float)height - 1);
+        if (first > last) continue;
+        for (int b = (int)first / bandHeight; b <= (int)last / bandHeight; ++b) bins[b].push_back(entry);
+    }
+}
+
+static void drawBand(const std::vector<BinEntry> &bin)
+{
+    size_t next = 0;
+    replayDraws(draws, [&](size_t index, const RecordedDraw &d) {
+        for (; next < bin.size() && bin[next].draw == index; ++next) d.draw(bin[next].triangle);
+    });
+}
+
+bool renderBanded(const std::string &filename)
+{
+    png_writer_t *writer = open_png_writer(width, height, filename.c_str());
+    if (!writer)
+    {
+        std::cerr << "Error: can't write " << filename << std::endl;
+        return false;
+    }
+    std::cout << "saving img to ... " << filename << std::endl;
+
+    img = acquireRenderTarget(width, bandHeight, bandLayout);
+    if (depthEnabled) initDepthBuffer(width, bandHeight);
+    std::vector<pixel_t> row(width);
+    for (size_t b = 0; b < bins.size(); ++b)
+    {
+        int y0 = (int)b * bandHeight, y1 = std::min(y0 + bandHeight, height);
+        img->clear();
+        if (depthEnabled) depthBuffer.clear();
+        imgOriginY = y0;
+        scissor = {0, y0, width, y1};
+        if (prepassEnabled) drawWithPrepass([&] { drawBand(bins[b]); });
+        else drawBand(bins[b]);
+
+        for (int y = y0; y < y1; ++y)
+        {
+            img->readRow(y - y0, row.data());
+            write_png_row(writer, row.data());
+        }
+        std::vector<BinEntry>().swap(bins[b]);
+    }
+    close_png_writer(writer);
+
+    imgOriginY = 0;
+    scissor = {0, 0, width, height};
+    releaseRenderTarget(img);
+    img = nullptr;
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "rasterizer.h"
+
+/*
+Banded rendering: output images larger than memory.
+
+    budget 256                      # MiB for color and depth, before png
+    png 32768 32768 poster.png
+
+Draws are recorded and binned by the horizontal bands they touch. At the
+end of the scene the bands are rendered top to bottom into one band-sized
+color and depth target, and each finished band's rows go straight into the
+PNG file, so the full image is never held. The recorded triangles still
+grow with the scene, not with the output size.
+
+Mode settings apply to the whole scene, as they are read when the bands
+are drawn; the depth pre-pass runs per band.
+*/
+
+extern size_t memoryBudget;     // bytes for the band targets; 0: render whole images
+
+void resetBanded();
+bool bandedActive();
+void startBanded(int width, int height);
+void recordBandedDraw(const std::vector<Vertex> &triangles);
+bool renderBanded(const std::string &filename);
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sched.h>
+
+#include "rasterizer.h"
+#include "sequence.h"
+#include "coordinator.h"
+#include "daemon.h"
+
+/*
+Kernel microbenchmarks for rasterizer.cpp.
+
+    make bench                  # build and run, pinned to CPU 0
+    ./rasterbench [cpu] [filter]
+
+Each benchmark is warmed up, then timed over BENCH_REPS repetitions of a
+calibrated number of iterations; the median repetition is reported as
+ns/op and items/s. rasterizer.cpp is built with -DNDEBUG here, which
+compiles out its per-pixel debug logging. The scene globals and the scene
+file loader are main.cpp's, built without its main().
+*/
+
+constexpr int BENCH_SIZE = 1024;        // render target is BENCH_SIZE x BENCH_SIZE
+constexpr int BENCH_REPS = 7;
+constexpr double BENCH_WARMUP_S = 0.05;
+constexpr double BENCH_REP_S = 0.1;
+
+static std::string filter;
+volatile float sink;
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds(Clock::time_point a, Clock::time_point b)
+{
+    return std::chrono::duration<double>(b - a).count();
+}
+
+// Time op(); each call processes itemsPerOp items (fragments, triangles, ...)
+template <class F>
+static void run(const std::string &name, double itemsPerOp, const char *unit, F op)
+{
+    if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+    // Warm-up, also calibrates the iterations per repetition
+    long iterations = 0;
+    Clock::time_point start = Clock::now();
+    while (seconds(start, Clock::now()) < BENCH_WARMUP_S)
+    {
+        op();
+        ++iterations;
+    }
+    long perRep = std::max(1L, (long)(iterations * BENCH_REP_S / BENCH_WARMUP_S));
+
+    std::vector<double> nsPerOp;
+    for (int r = 0; r < BENCH_REPS; ++r)
+    {
+        Clock::time_point a = Clock::now();
+        for (long i = 0; i < perRep; ++i) op();
+        Clock::time_point b = Clock::now();
+        nsPerOp.push_back(seconds(a, b) * 1e9 / perRep);
+    }
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+    double median = nsPerOp[BENCH_REPS / 2];
+    std::printf("%-36s %12.1f ns/op %14.3e %s/s   (min %.1f, max %.1f)\n", name.c_str(), median,
+                itemsPerOp * 1e9 / median, unit, nsPerOp.front(), nsPerOp.back());
+}
+
+static Vertex vertex(float x, float y, float z)
+{
+    return Vertex(Vec4(x, y, z, 1), Vec4(x / BENCH_SIZE, y / BENCH_SIZE, 0.5f, 1), Vec2(0, 0));
+}
+
+static void setModes(bool depth, bool sRGB, bool hyp)
+{
+    depthEnabled = depth;
+    sRGBEnabled = sRGB;
+    hypEnabled = hyp;
+    if (depth)
+    {
+        // init() keeps a matching buffer as it is, depth from the previous benchmark included
+        depthBuffer.init(BENCH_SIZE, BENCH_SIZE, DEPTH_FLOAT32, img->layout());
+        depthBuffer.clear();
+    }
+}
+
+
+static void benchSetup()
+{
+    Vertex a = vertex(10.3f, 20.7f, 0.2f), b = vertex(500.1f, 40.9f, 0.4f), c = vertex(200.5f, 700.2f, 0.6f);
+    for (int hyp = 0; hyp < 2; ++hyp)
+    {
+        setModes(false, false, hyp);
+        TriangleSetup tri;
+        run(std::string("setupTriangle") + (hyp ? " hyp" : ""), 1, "tri", [&] {
+            setupTriangle(a, b, c, activeVaryings(), tri);
+            sink = tri.z.dx;
+        });
+    }
+}
+
+static void benchSpans()
+{
+    setModes(false, false, false);
+    TriangleSetup tri;
+    setupTriangle(vertex(0, 0, 0.5f), vertex(BENCH_SIZE, 0, 0.5f), vertex(0, BENCH_SIZE, 0.5f), activeVaryings(), tri);
+    for (int length : {1, 8, 64, 512})
+    {
+        int y = 0;
+        run("DDA span " + std::to_string(length), 1, "span", [&] {
+            DDA(tri, 0.5f, 0.5f + length, y);
+            y = (y + 1) % BENCH_SIZE;
+        });
+    }
+}
+
+static void benchSetPixel()
+{
+    // one row's worth of fragments, walking down the image
+    std::vector<Fragment> row(BENCH_SIZE);
+    for (int x = 0; x < BENCH_SIZE; ++x)
+    {
+        Fragment &f = row[x];
+        f.x = x;
+        f.z = 0.5f;
+        f.numVaryings = VARYING_TEXCOORD;
+        f.varyings[VARYING_COLOR + 0] = x / (float)BENCH_SIZE;
+        f.varyings[VARYING_COLOR + 1] = 0.25f;
+        f.varyings[VARYING_COLOR + 2] = 0.75f;
+        f.varyings[VARYING_COLOR + 3] = 1;
+    }
+    for (int mode = 0; mode < 4; ++mode)
+    {
+        bool depth = mode & 1, sRGB = mode & 2;
+        setModes(depth, sRGB, false);
+        int y = 0;
+        float z = 0.5f;
+        std::string name = std::string("setPixel") + (depth ? " depth" : "") + (sRGB ? " sRGB" : "");
+        run(name, BENCH_SIZE, "frag", [&] {
+            for (Fragment &f : row)
+            {
+                f.y = y;
+                f.z = z;
+                setPixel(f);
+            }
+            if (++y == BENCH_SIZE) { y = 0; z -= 1e-6f; }   // keep passing the depth test
+        });
+    }
+}
+
+static void benchSRGB()
+{
+    std::vector<float> values(1024);
+    for (size_t i = 0; i < values.size(); ++i) values[i] = i / 1023.0f;
+    run("converToSRGB", values.size(), "value", [&] {
+        float sum = 0;
+        for (float v : values) sum += converToSRGB(v);
+        sink = sum;
+    });
+}
+
+static void benchTriangles()
+{
+    // right triangles with legs of the given size, spread across the image
+    for (int size : {1, 10, 100, BENCH_SIZE})
+    {
+        for (int hyp = 0; hyp < 2; ++hyp)
+        {
+            setModes(true, false, hyp);
+            int i = 0;
+            float z = 0.5f;
+            std::string name = "Scanline " + std::to_string(size) + "px" + (hyp ? " hyp" : "");
+            run(name, 1, "tri", [&] {
+                float x = (float)((i * 37) % (BENCH_SIZE - size + 1)) + 0.25f;
+                float y = (float)((i * 101) % (BENCH_SIZE - size + 1)) + 0.25f;
+                Scanline(vertex(x, y, z), vertex(x + size, y, z), vertex(x, y + size, z));
+                ++i;
+                z -= 1e-7f;
+            });
+        }
+    }
+}
+
+static void benchSphere()
+{
+    // 1M-triangle UV sphere filling a 512x512 target: almost every triangle
+    // covers zero to a few pixels
+    const int size = 512, stacks = 500, slices = 1000;
+    const float pi = 3.14159265f, radius = 0.45f * size;
+    std::vector<Vertex> grid;
+    for (int i = 0; i <= stacks; ++i)
+    {
+        float phi = pi * i / stacks;
+        for (int j = 0; j <= slices; ++j)
+        {
+            float theta = 2 * pi * j / slices;
+            float x = size / 2 + radius * std::sin(phi) * std::cos(theta);
+            float y = size / 2 + radius * std::cos(phi);
+            float z = 0.5f + 0.4f * std::sin(phi) * std::sin(theta);
+            grid.push_back(vertex(x, y, z));
+        }
+    }
+    std::vector<Vertex> tris;
+    for (int i = 0; i < stacks; ++i)
+    {
+        for (int j = 0; j < slices; ++j)
+        {
+            const Vertex &a = grid[i * (slices + 1) + j], &b = grid[i * (slices + 1) + j + 1];
+            const Vertex &c = grid[(i + 1) * (slices + 1) + j], &d = grid[(i + 1) * (slices + 1) + j + 1];
+            tris.insert(tris.end(), {a, b, c, c, b, d});
+        }
+    }
+
+    RenderTarget *full = img;
+    img = new RenderTarget(size, size);
+    scissor = {0, 0, size, size};
+    setModes(false, false, false);
+    depthEnabled = true;
+    depthBuffer.init(size, size, DEPTH_FLOAT32, img->layout());
+    run("sphere 1M tris 512x512", tris.size() / 3, "tri", [&] {
+        depthBuffer.clear();
+        for (size_t i = 0; i + 2 < tris.size(); i += 3) Scanline(tris[i], tris[i + 1], tris[i + 2]);
+    });
+    delete img;
+    img = full;
+    scissor = {0, 0, BENCH_SIZE, BENCH_SIZE};
+}
+
+static void benchSequence()
+{
+    // Sequence frame where one 192x192 quad of a 131k-triangle scene moves by
+    // 8px: 49 of the 1024 tiles (4.8%) are dirty per frame
+    const int cell = 4, quad = 192;
+    std::vector<Vertex> grid;
+    for (int y = 0; y < BENCH_SIZE; y += cell)
+    {
+        for (int x = 0; x < BENCH_SIZE; x += cell)
+        {
+            Vertex a = vertex(x, y, 0.75f), b = vertex(x + cell, y, 0.75f);
+            Vertex c = vertex(x, y + cell, 0.75f), d = vertex(x + cell, y + cell, 0.75f);
+            grid.insert(grid.end(), {a, b, c, c, b, d});
+        }
+    }
+    auto moved = [&](int i) {
+        float x = 8.0f * (i % 100) + 0.5f, y = 300.5f;
+        Vertex a = vertex(x, y, 0.25f), b = vertex(x + quad, y, 0.25f);
+        Vertex c = vertex(x, y + quad, 0.25f), d = vertex(x + quad, y + quad, 0.25f);
+        return std::vector<Vertex>{a, b, c, c, b, d};
+    };
+
+    setModes(true, false, false);
+    resetSequence();
+    recordDraw(-1, grid);
+    recordDraw(-1, moved(0));
+    renderDirtyTiles();
+    int i = 1;
+    run("sequence frame 4.8% dirty", 1, "frame", [&] {
+        recordDraw(1, moved(i++));
+        renderDirtyTiles();
+    });
+    resetSequence();
+}
+
+// Load a rasterizer-files scene through main.cpp's parser at BENCH_SIZE x
+// BENCH_SIZE, recording its draws (sequence mode) instead of rasterizing them
+static bool loadScene(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::fprintf(stderr, "Error opening %s\n", path.c_str());
+        return false;
+    }
+    std::stringstream scene;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream iss(line);
+        std::string keyword, name;
+        int width, height;
+        if (iss >> keyword && keyword == "png" && iss >> width >> height >> name)
+            line = "png " + std::to_string(BENCH_SIZE) + " " + std::to_string(BENCH_SIZE) + " " + name;
+        scene << line << "\n";
+    }
+    resetScene();
+    sequenceEnabled = true;
+    std::streambuf *out = std::cout.rdbuf(nullptr);    // the parser's debug logging
+    renderScene(scene);
+    std::cout.rdbuf(out);
+    return img != nullptr;
+}
+
+static void benchDepthFormats()
+{
+    // rast-depth and rast-perspective at BENCH_SIZE x BENCH_SIZE, one frame
+    // (depth clear and every draw) per op, in each depth format
+    RenderTarget *full = img;
+    img = nullptr;
+    for (const char *name : {"rast-depth", "rast-perspective"})
+    {
+        if (!loadScene(std::string("rasterizer-files/") + name + ".txt")) continue;
+        for (DepthFormat format : {DEPTH_FLOAT32, DEPTH_UNORM24, DEPTH_UNORM16})
+        {
+            depthBuffer.init(BENCH_SIZE, BENCH_SIZE, format, img->layout());
+            run(std::string(name) + " depth " + depthBuffer.formatName(), 1, "frame", [&] {
+                depthBuffer.clear();
+                replayDraws(recordedDraws(), [](size_t, const DrawCall &d) {
+                    for (size_t t = 0; t < d.triangleCount(); ++t) d.draw(t);
+                });
+            });
+        }
+    }
+    resetScene();
+    img = full;
+    scissor = {0, 0, BENCH_SIZE, BENCH_SIZE};
+}
+
+// Pin to one CPU so runs are repeatable
+static void pinCpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) std::perror("sched_setaffinity");
+    else std::printf("Pinned to CPU %d\n", cpu);
+}
+
+int main(int argc, char *argv[])
+{
+    pinCpu((argc > 1) ? std::atoi(argv[1]) : 0);
+    if (argc > 2) filter = argv[2];
+
+    img = new RenderTarget(BENCH_SIZE, BENCH_SIZE);
+    scissor = {0, 0, BENCH_SIZE, BENCH_SIZE};
+    std::printf("Render target %dx%d, %d reps after %.0f ms warm-up, median reported\n",
+                BENCH_SIZE, BENCH_SIZE, BENCH_REPS, BENCH_WARMUP_S * 1000);
+
+    benchSetup();
+    benchSpans();
+    benchSetPixel();
+    benchSRGB();
+    benchTriangles();
+    benchSphere();
+    benchDepthFormats();
+    benchSequence();
+
+    delete img;
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "coordinator.h"
+
+using namespace std;
+
+extern std::string fileName;
+
+
+static bool writeAll(int fd, const void *data, size_t size)
+{
+    const char *p = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *data, size_t size)
+{
+    char *p = static_cast<char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+
+// Worker process: render the scene from sceneFd, send rows [y0, y1) to resultFd
+static void runWorker(int sceneFd, int resultFd, int y0, int y1)
+{
+    int devNull = open("/dev/null", O_WRONLY);
+    if (devNull >= 0) dup2(devNull, STDOUT_FILENO);
+
+    std::string scene;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(sceneFd, buffer, sizeof(buffer))) > 0) scene.append(buffer, n);
+    close(sceneFd);
+
+    renderRegion = {0, y0, INT32_MAX, y1};
+    std::istringstream iss(scene);
+    renderScene(iss);
+    if (!img) _exit(1);
+
+    // img holds only the region, from image row imgOriginY == y0
+    std::vector<pixel_t> row(img->width());
+    for (int y = y0; y < y1; ++y)
+    {
+        img->readRow(y - imgOriginY, row.data());
+        if (!writeAll(resultFd, row.data(), row.size() * sizeof(pixel_t))) _exit(1);
+    }
+    close(resultFd);
+    _exit(0);
+}
+
+
+bool coordinateScene(int processes, const std::string &inputFile)
+{
+    std::ifstream infile(inputFile);
+    if (!infile)
+    {
+        std::cerr << "Error opening the file! Terminating the program" << std::endl;
+        return false;
+    }
+    std::stringstream contents;
+    contents << infile.rdbuf();
+    std::string scene = contents.str();
+
+    // Only the png line is needed here; the workers parse everything else
+    int width = 0, height = 0;
+    std::string name, inputLine;
+    std::istringstream lines(scene);
+    while (std::getline(lines, inputLine))
+    {
+        std::istringstream iss(inputLine);
+        std::string keyword;
+        iss >> keyword;
+        if (keyword == "png" && width == 0) iss >> width >> height >> name;
+        if (keyword == "sequence" || keyword == "budget")
+        {
+            std::cerr << "Sequence and banded scenes are rendered in one process." << std::endl;
+            return false;
+        }
+    }
+    if (width <= 0 || height <= 0) return false;
+    processes = std::max(1, std::min(processes, height));
+
+    struct Worker { pid_t pid; int resultFd; int y0, y1; };
+    std::vector<Worker> workers;
+    // Before falling back to one process, stop the workers already started
+    auto abandon = [&workers]() {
+        for (const Worker &w : workers)
+        {
+            kill(w.pid, SIGKILL);
+            close(w.resultFd);
+            waitpid(w.pid, nullptr, 0);
+        }
+        return false;
+    };
+    for (int i = 0; i < processes; ++i)
+    {
+        int sceneFds[2], resultFds[2];
+        if (pipe(sceneFds) != 0)
+        {
+            std::perror("pipe");
+            return abandon();
+        }
+        if (pipe(resultFds) != 0)
+        {
+            std::perror("pipe");
+            close(sceneFds[0]);
+            close(sceneFds[1]);
+            return abandon();
+        }
+        int y0 = height * i / processes, y1 = height * (i + 1) / processes;
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            std::perror("fork");
+            for (int fd : {sceneFds[0], sceneFds[1], resultFds[0], resultFds[1]}) close(fd);
+            return abandon();
+        }
+        if (pid == 0)
+        {
+            close(sceneFds[1]);
+            close(resultFds[0]);
+            for (const Worker &w : workers) close(w.resultFd);
+            runWorker(sceneFds[0], resultFds[1], y0, y1);
+        }
+        close(sceneFds[0]);
+        close(resultFds[1]);
+        bool sent = writeAll(sceneFds[1], scene.data(), scene.size());
+        close(sceneFds[1]);
+        if (!sent) std::cerr << "Error sending the scene to worker " << i << std::endl;
+        workers.push_back({pid, resultFds[0], y0, y1});
+    }
+    std::cout << "Rendering " << width << "x" << height << " in " << processes << " worker processes." << std::endl;
+
+    // Composite the regions
+    img = acquireRenderTarget(width, height, LAYOUT_TILED);
+    fileName = name;
+    bool ok = true;
+    std::vector<pixel_t> row(width);
+    for (const Worker &w : workers)
+    {
+        for (int y = w.y0; y < w.y1 && ok; ++y)
+        {
+            ok = readAll(w.resultFd, row.data(), row.size() * sizeof(pixel_t));
+            for (int x = 0; x < width && ok; ++x) img->at(x, y) = row[x];
+        }
+        close(w.resultFd);
+        int status = 0;
+        waitpid(w.pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    }
+    if (!ok) std::cerr << "Error: a worker process failed." << std::endl;
+    return ok;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <istream>
+#include <string>
+#include "rasterizer.h"
+
+/*
+Sort-first multi-process rendering.
+
+    ./program --processes N scene.txt
+
+The coordinator reads the scene and splits the image into N horizontal
+regions. It forks one worker process per region and sends it the scene
+over a pipe. Each worker renders the whole scene scissored to its region,
+so triangles outside it are rejected before setup, into a target holding
+only the region's rows (imgOriginY is the region's first row), and writes
+them back over a second pipe. The coordinator composites them into img.
+Every pixel goes through exactly the same code as in a single-process
+render, so the output is byte-identical.
+*/
+
+// Scissor applied to everything rendered by this process (a worker's region)
+extern Rect renderRegion;
+
+// Parse and rasterize a whole scene into img (main.cpp)
+void renderScene(std::istream &infile);
+
+// Render inputFile across processes into img and fileName; false if it cannot be split
+bool coordinateScene(int processes, const std::string &inputFile);
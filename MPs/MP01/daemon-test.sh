@@ -0,0 +1,46 @@
+#!/bin/sh
+# Render every rasterizer-files scene through a fresh daemon, with the png
+# written by the daemon (file) and sent back (inline), and compare both with
+# a direct render. Exits non-zero if any differs.
+cd "$(dirname "$0")/rasterizer-files" || exit 1
+socket=/tmp/rasterd-test-$$.sock
+out=/tmp/rasterd-test-$$
+mkdir -p "$out"
+
+../program --daemon "$socket" 2 >/dev/null 2>&1 &
+daemon=$!
+trap 'kill $daemon 2>/dev/null; wait $daemon 2>/dev/null; rm -rf "$out" "$socket"' EXIT
+tries=0
+while [ ! -S "$socket" ] && [ $tries -lt 50 ]; do sleep 0.1; tries=$((tries + 1)); done
+
+failed=0
+for scene in rast-*.txt; do
+    # The png the scene names, or its last frame for a sequence without one
+    png=$(awk '$1 == "png" { print $4; exit }' "$scene")
+    ../program "$scene" >/dev/null 2>&1
+    [ -s "$png" ] || png=$(awk '$1 == "frame" { name = $2 } END { print name }' "$scene")
+    if [ ! -s "$png" ]; then
+        echo "$scene: no direct render"
+        failed=1
+        continue
+    fi
+    mv "$png" "$out/direct.png"
+    rm -f sequence-*.png
+    status=ok
+
+    reply=$(../rasterclient "$socket" "$scene") && written=${reply% (*}
+    if [ -z "$reply" ] || ! cmp -s "$written" "$out/direct.png"; then
+        status="file mode differs ($reply)"
+    fi
+    rm -f "$written" sequence-*.png
+
+    if ! ../rasterclient "$socket" "$scene" "$out/inline.png" >/dev/null || ! cmp -s "$out/inline.png" "$out/direct.png"; then
+        status="$status, inline mode differs"
+    fi
+    rm -f "$out/inline.png" sequence-*.png
+    [ "$status" = ok ] || failed=1
+    echo "$scene: $status"
+done
+
+../rasterclient "$socket" --stats
+exit $failed
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "daemon.h"
+#include "coordinator.h"
+#include "sequence.h"
+
+using namespace std;
+
+extern std::string fileName;
+
+// Shared by every worker process
+struct DaemonStats {
+    std::atomic<uint64_t> jobs;
+    std::atomic<uint64_t> failed;
+    float latencyMs[DAEMON_LATENCY_WINDOW];     // ring, indexed by job number
+};
+
+static DaemonStats *stats = nullptr;
+static int workerCount = 0;
+static volatile sig_atomic_t stopping = 0;
+
+using Clock = std::chrono::steady_clock;
+
+
+static bool sendAll(int fd, const void *data, size_t size)
+{
+    const char *p = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void reply(int fd, const std::string &text)
+{
+    sendAll(fd, text.data(), text.size());
+}
+
+static std::string statsLine()
+{
+    uint64_t jobs = stats->jobs, failed = stats->failed;
+    std::vector<float> latencies(stats->latencyMs, stats->latencyMs + std::min<uint64_t>(jobs, DAEMON_LATENCY_WINDOW));
+    float p50 = 0, p99 = 0;
+    if (!latencies.empty())
+    {
+        std::sort(latencies.begin(), latencies.end());
+        p50 = latencies[(latencies.size() - 1) * 50 / 100];
+        p99 = latencies[(latencies.size() - 1) * 99 / 100];
+    }
+    char line[160];
+    std::snprintf(line, sizeof(line), "jobs %llu failed %llu p50_ms %.3f p99_ms %.3f workers %d\n",
+                  (unsigned long long)jobs, (unsigned long long)failed, p50, p99, workerCount);
+    return line;
+}
+
+// Render one scene in the current directory; returns the reply
+static std::string renderHere(const std::string &mode, const std::string &scene, std::string &png)
+{
+    char tmp[] = "/tmp/rasterd-XXXXXX.png";
+    if (mode == "inline")
+    {
+        int fd = mkstemps(tmp, 4);
+        if (fd < 0) return "error can't create a temporary file\n";
+        close(fd);
+        outputPath = tmp;
+    }
+
+    resetScene();
+    std::istringstream iss(scene);
+    renderScene(iss);
+    bool saved = saveScene();
+    outputPath.clear();
+
+    // A sequence without a final frame under the png name returns its last frame
+    auto written = [](const std::string &path) {
+        struct stat st;
+        return !path.empty() && stat(path.c_str(), &st) == 0 && st.st_size > 0;
+    };
+    std::string produced = fileName;
+    if (sequenceEnabled && !written(produced)) produced = lastFrameFile();
+    if (!saved || !written(produced))
+    {
+        if (mode == "inline") unlink(tmp);
+        return "error no image rendered\n";
+    }
+    if (mode == "file")
+    {
+        char cwd[PATH_MAX];
+        if (produced[0] != '/' && getcwd(cwd, sizeof(cwd))) produced = std::string(cwd) + "/" + produced;
+        return "ok " + produced + "\n";
+    }
+
+    std::ifstream file(produced, std::ios::binary);
+    std::stringstream bytes;
+    bytes << file.rdbuf();
+    png = bytes.str();
+    unlink(tmp);
+    return "ok " + std::to_string(png.size()) + "\n";
+}
+
+// Render one scene with relative paths resolved against dir (the worker's own
+// directory if empty); the worker's directory is restored for the next job
+static std::string renderJob(const std::string &mode, const std::string &dir, const std::string &scene, std::string &png)
+{
+    if (mode != "file" && mode != "inline") return "error unknown reply mode " + mode + "\n";
+    int home = open(".", O_RDONLY | O_DIRECTORY);
+    if (home < 0) return "error can't open the working directory\n";
+    std::string status;
+    if (!dir.empty() && chdir(dir.c_str()) != 0) status = "error can't enter " + dir + "\n";
+    else status = renderHere(mode, scene, png);
+    if (fchdir(home) != 0) std::perror("fchdir");
+    close(home);
+    return status;
+}
+
+static void serve(int fd)
+{
+    std::string request;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) request.append(buffer, n);
+
+    size_t headerEnd = request.find('\n');
+    std::string header = request.substr(0, headerEnd);
+    std::string body = (headerEnd == std::string::npos) ? "" : request.substr(headerEnd + 1);
+    std::istringstream iss(header);
+    std::string command, mode, dir;
+    iss >> command >> mode;
+    std::getline(iss >> std::ws, dir);
+
+    if (command == "stats")
+    {
+        reply(fd, statsLine());
+        return;
+    }
+    if (command != "render")
+    {
+        reply(fd, "error unknown command " + command + "\n");
+        return;
+    }
+
+    Clock::time_point start = Clock::now();
+    std::string png;
+    std::string status = renderJob(mode, dir, body, png);
+    bool ok = status.compare(0, 3, "ok ") == 0;
+    reply(fd, status);
+    if (ok && !png.empty()) sendAll(fd, png.data(), png.size());
+
+    float ms = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    uint64_t job = stats->jobs.fetch_add(1);
+    stats->latencyMs[job % DAEMON_LATENCY_WINDOW] = ms;
+    if (!ok) stats->failed.fetch_add(1);
+}
+
+static void worker(int listenFd)
+{
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    int devNull = open("/dev/null", O_WRONLY);
+    if (devNull >= 0) dup2(devNull, STDOUT_FILENO);
+    bufferCacheEnabled = true;
+
+    while (true)
+    {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR) continue;
+            std::perror("accept");
+            _exit(1);
+        }
+        serve(fd);
+        close(fd);
+    }
+}
+
+static pid_t spawnWorker(int listenFd)
+{
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) worker(listenFd);
+    if (pid < 0) std::perror("fork");
+    return pid;
+}
+
+static void onStop(int)
+{
+    stopping = 1;
+}
+
+
+int runDaemon(const std::string &socketPath, int workers)
+{
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (listenFd < 0 || socketPath.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "Error: can't create socket " << socketPath << std::endl;
+        return 1;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    unlink(socketPath.c_str());
+    if (bind(listenFd, (sockaddr *)&address, sizeof(address)) != 0 || listen(listenFd, 128) != 0)
+    {
+        std::perror(socketPath.c_str());
+        return 1;
+    }
+
+    void *shared = mmap(nullptr, sizeof(DaemonStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+    {
+        std::perror("mmap");
+        return 1;
+    }
+    stats = new (shared) DaemonStats();
+    workerCount = workers;
+
+    // No SA_RESTART, so wait() returns when asked to stop
+    struct sigaction action = {};
+    action.sa_handler = onStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::vector<pid_t> pids;
+    for (int i = 0; i < workers; ++i) pids.push_back(spawnWorker(listenFd));
+    std::cout << "Listening on " << socketPath << " with " << workers << " workers." << std::endl;
+
+    // Replace workers that die
+    while (!stopping)
+    {
+        int status = 0;
+        pid_t pid = wait(&status);
+        if (pid < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        auto found = std::find(pids.begin(), pids.end(), pid);
+        if (found == pids.end() || stopping) continue;
+        std::cerr << "Worker " << pid << " exited, restarting it." << std::endl;
+        *found = spawnWorker(listenFd);
+    }
+
+    for (pid_t pid : pids) if (pid > 0) kill(pid, SIGTERM);
+    for (pid_t pid : pids) if (pid > 0) waitpid(pid, nullptr, 0);
+    close(listenFd);
+    unlink(socketPath.c_str());
+    std::cout << statsLine();
+    return 0;
+}
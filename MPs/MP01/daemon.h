@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/*
+Render daemon: a long-running process serving scene jobs over a Unix socket.
+
+    ./program --daemon /tmp/rasterd.sock [jobs]
+    ./rasterclient /tmp/rasterd.sock scene.txt [out.png]
+    ./rasterclient /tmp/rasterd.sock --stats
+
+`jobs` worker processes (default: one per hardware thread) each accept and
+render one job at a time, so up to `jobs` scenes render concurrently and the
+rest wait in the listen queue. Workers stay warm between jobs: render
+targets and depth buffers are pooled by size, decoded textures stay in the
+texture cache, and parsed position, color and texcoord lines are reused
+when a scene repeats them. A worker that dies is replaced.
+
+One request per connection; the client shuts down its sending side after
+the request:
+
+    render file <dir>\n<scene>      ->  ok <path>\n              png written as named, relative to dir
+                                                                (the daemon's directory if empty); absolute path
+    render inline <dir>\n<scene>    ->  ok <size>\n<png bytes>
+    stats\n                         ->  jobs <n> failed <n> p50_ms <t> p99_ms <t> workers <n>\n
+
+Failures reply `error <message>\n`. Scenes are the usual text format.
+
+    make daemon-test                # every scene through the daemon, diffed with direct renders
+*/
+
+// Jobs the latency percentiles are computed over (the most recent ones)
+constexpr int DAEMON_LATENCY_WINDOW = 4096;
+// Parsed buffer lines a worker keeps across jobs
+constexpr size_t BUFFER_CACHE_BYTES = 64 << 20;
+
+int runDaemon(const std::string &socketPath, int workers);
+
+// Scene state, main.cpp
+extern std::string outputPath;
+extern bool bufferCacheEnabled;
+void resetScene();
+bool saveScene();
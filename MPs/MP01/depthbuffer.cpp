@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include "depthbuffer.h"
+
+using namespace std;
+
+static thread_local DepthStats localStats;
+static std::atomic<uint64_t> totalTests(0), totalWrites(0), totalFlagBits(0);
+
+
+bool parseDepthFormat(const std::string &name, DepthFormat &format)
+{
+    if (name == "float32") format = DEPTH_FLOAT32;
+    else if (name == "unorm24") format = DEPTH_UNORM24;
+    else if (name == "unorm16") format = DEPTH_UNORM16;
+    else return false;
+    return true;
+}
+
+void DepthBuffer::init(int w, int h, DepthFormat format, RenderLayout memoryLayout)
+{
+    if (matches(w, h, format, memoryLayout)) return;
+    width = w;
+    height = h;
+    fmt = format;
+    layout = memoryLayout;
+    tilesX = (width + DEPTH_TILE - 1) / DEPTH_TILE;
+    tilesY = (height + DEPTH_TILE - 1) / DEPTH_TILE;
+    texels.assign(layoutSize(layout, width, height) * bytesPerTexel(), 0);
+    tileCleared.assign((size_t)tilesX * tilesY, 1);
+}
+
+size_t DepthBuffer::bytesPerTexel() const
+{
+    switch (fmt)
+    {
+        case DEPTH_UNORM24: return 3;
+        case DEPTH_UNORM16: return 2;
+        default: return 4;
+    }
+}
+
+const char *DepthBuffer::formatName() const
+{
+    switch (fmt)
+    {
+        case DEPTH_UNORM24: return "unorm24";
+        case DEPTH_UNORM16: return "unorm16";
+        default: return "float32";
+    }
+}
+
+
+void DepthBuffer::clear()
+{
+    std::fill(tileCleared.begin(), tileCleared.end(), 1);
+}
+
+// Clear [x0, x1) x [y0, y1): whole tiles are flagged, partial tiles filled
+void DepthBuffer::clearRect(int x0, int y0, int x1, int y1)
+{
+    x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+    x1 = std::min(x1, width); y1 = std::min(y1, height);
+    for (int ty = y0 / DEPTH_TILE; ty * DEPTH_TILE < y1; ++ty)
+    {
+        for (int tx = x0 / DEPTH_TILE; tx * DEPTH_TILE < x1; ++tx)
+        {
+            int tileX0 = tx * DEPTH_TILE, tileY0 = ty * DEPTH_TILE;
+            int tileX1 = std::min(tileX0 + DEPTH_TILE, width), tileY1 = std::min(tileY0 + DEPTH_TILE, height);
+            uint8_t &flag = tileCleared[ty * tilesX + tx];
+            if (flag) continue;
+            if (x0 <= tileX0 && y0 <= tileY0 && tileX1 <= x1 && tileY1 <= y1)
+            {
+                flag = 1;
+                continue;
+            }
+            uint32_t clearValue = quantize(std::numeric_limits<float>::infinity());
+            for (int y = std::max(y0, tileY0); y < std::min(y1, tileY1); ++y)
+            {
+                for (int x = std::max(x0, tileX0); x < std::min(x1, tileX1); ++x)
+                {
+                    size_t index = layoutIndex(layout, width, x, y);
+                    store(index, clearValue);
+                }
+            }
+        }
+    }
+}
+
+void DepthBuffer::fillTile(int tx, int ty)
+{
+    uint32_t clearValue = quantize(std::numeric_limits<float>::infinity());
+    int x1 = std::min((tx + 1) * DEPTH_TILE, width);
+    int y1 = std::min((ty + 1) * DEPTH_TILE, height);
+    for (int y = ty * DEPTH_TILE; y < y1; ++y)
+    {
+        for (int x = tx * DEPTH_TILE; x < x1; ++x)
+        {
+            size_t index = layoutIndex(layout, width, x, y);
+            store(index, clearValue);
+        }
+    }
+    tileCleared[ty * tilesX + tx] = 0;
+}
+
+
+// Stored representation of z: float bits, or unorm of (z + 1) / 2 clamped to [0, 1].
+// The largest unorm value is kept for the clear value (+infinity), so that
+// fragments on the far plane still pass against a cleared pixel, as with float32.
+uint32_t DepthBuffer::quantize(float z) const
+{
+    if (fmt == DEPTH_FLOAT32)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &z, 4);
+        return bits;
+    }
+    uint32_t maxValue = (fmt == DEPTH_UNORM24) ? 0xFFFFFF : 0xFFFF;
+    if (z == std::numeric_limits<float>::infinity()) return maxValue;
+    float v = (z + 1.0f) * 0.5f;
+    if (!(v > 0.0f)) return 0;
+    if (v >= 1.0f) return maxValue - 1;
+    return (uint32_t)(v * (maxValue - 1) + 0.5f);
+}
+
+uint32_t DepthBuffer::load(size_t index) const
+{
+    uint32_t value = 0;
+    std::memcpy(&value, &texels[index * bytesPerTexel()], bytesPerTexel());   // little endian
+    return value;
+}
+
+void DepthBuffer::store(size_t index, uint32_t value)
+{
+    std::memcpy(&texels[index * bytesPerTexel()], &value, bytesPerTexel());
+}
+
+
+bool DepthBuffer::testAndSet(int x, int y, float z)
+{
+    uint8_t &flag = tileCleared[(y / DEPTH_TILE) * tilesX + x / DEPTH_TILE];
+    if (flag) fillTile(x / DEPTH_TILE, y / DEPTH_TILE);
+    ++localStats.tests;
+
+    size_t index = layoutIndex(layout, width, x, y);
+    bool pass;
+    if (fmt == DEPTH_FLOAT32)
+    {
+        float current;
+        std::memcpy(&current, &texels[index * 4], 4);
+        pass = z < current;
+        if (pass) std::memcpy(&texels[index * 4], &z, 4);
+    }
+    else
+    {
+        uint32_t q = quantize(z);
+        pass = q < load(index);
+        if (pass) store(index, q);
+    }
+    if (pass) ++localStats.writes;
+    return pass;
+}
+
+
+bool DepthBuffer::testEqual(int x, int y, float z)
+{
+    uint8_t &flag = tileCleared[(y / DEPTH_TILE) * tilesX + x / DEPTH_TILE];
+    if (flag) fillTile(x / DEPTH_TILE, y / DEPTH_TILE);
+    ++localStats.tests;
+
+    size_t index = layoutIndex(layout, width, x, y);
+    uint64_t &word = consumed[index / 64], bit = (uint64_t)1 << (index % 64);
+    ++localStats.flagBits;
+    if ((word & bit) || quantize(z) != load(index)) return false;
+    word |= bit;
+    ++localStats.flagBits;
+    return true;
+}
+
+void DepthBuffer::beginEqualPass()
+{
+    consumed.assign((layoutSize(layout, width, height) + 63) / 64, 0);
+}
+
+// Free the flags; they are only needed while the pass runs
+void DepthBuffer::endEqualPass()
+{
+    std::vector<uint64_t>().swap(consumed);
+}
+
+
+void DepthBuffer::flushStats()
+{
+    totalTests += localStats.tests;
+    totalWrites += localStats.writes;
+    totalFlagBits += localStats.flagBits;
+    localStats = DepthStats();
+}
+
+DepthStats DepthBuffer::totalStats()
+{
+    DepthStats s;
+    s.tests = totalTests;
+    s.writes = totalWrites;
+    s.flagBits = totalFlagBits;
+    return s;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "layout.h"
+
+// Storage formats for the depth buffer
+enum DepthFormat {
+    DEPTH_FLOAT32,  // 4 bytes, any z, cleared to +infinity
+    DEPTH_UNORM24,  // 3 bytes, z in [-1, 1] mapped to [0, 2^24 - 2]
+    DEPTH_UNORM16   // 2 bytes, z in [-1, 1] mapped to [0, 2^16 - 2]
+};
+
+// Side length of a fast-clear tile in pixels
+constexpr int DEPTH_TILE = 16;
+
+// Depth buffers of other sizes the scene loader keeps for later scenes
+constexpr size_t DEPTH_BUFFER_POOL = 4;
+
+// Depth test counters, used to report depth bandwidth
+struct DepthStats {
+    uint64_t tests = 0;
+    uint64_t writes = 0;
+    uint64_t flagBits = 0;  // shade-equal flag bits read or set
+};
+
+/*
+A contiguous depth buffer in one of several formats.
+
+clear() only flags every tile as cleared (O(tiles)); a flagged tile is
+filled with the clear value the first time a fragment touches it. Tiles are
+never shared by two raster workers as long as their bands are DEPTH_TILE
+aligned.
+*/
+class DepthBuffer {
+  public:
+    void init(int width, int height, DepthFormat format, RenderLayout layout);
+    bool ready() const { return !texels.empty(); }
+    bool matches(int w, int h, DepthFormat format, RenderLayout memoryLayout) const {
+        return ready() && w == width && h == height && format == fmt && memoryLayout == layout;
+    }
+
+    void clear();
+    void clearRect(int x0, int y0, int x1, int y1);
+
+    // Depth test (less); stores z and returns true if it passes
+    bool testAndSet(int x, int y, float z);
+    // Depth test (equal), never stores z. Passes at most once per pixel
+    // between beginEqualPass() and endEqualPass(), so coplanar fragments shade
+    // it once, like a less test. The pass flags (one bit per pixel) only exist
+    // in between; passes are single-threaded, as bits share words across bands.
+    bool testEqual(int x, int y, float z);
+    void beginEqualPass();
+    void endEqualPass();
+
+    size_t bytesPerTexel() const;
+    DepthFormat format() const { return fmt; }
+    const char *formatName() const;
+
+    // Adds the calling thread's counters to the totals
+    static void flushStats();
+    static DepthStats totalStats();
+
+  private:
+    void fillTile(int tx, int ty);
+    uint32_t quantize(float z) const;
+    uint32_t load(size_t index) const;
+    void store(size_t index, uint32_t value);
+
+    int width = 0, height = 0;
+    int tilesX = 0, tilesY = 0;
+    DepthFormat fmt = DEPTH_FLOAT32;
+    RenderLayout layout = LAYOUT_LINEAR;
+    std::vector<uint8_t> texels;        // in layout order, bytesPerTexel() each
+    std::vector<uint8_t> tileCleared;   // 1: tile still holds the clear value lazily
+    std::vector<uint64_t> consumed;     // bit per pixel in layout order: testEqual passed in this pass
+};
+
+bool parseDepthFormat(const std::string &name, DepthFormat &format);
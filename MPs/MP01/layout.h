@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Memory layouts for render targets (color and depth)
+enum RenderLayout {
+    LAYOUT_LINEAR,  // row-major
+    LAYOUT_TILED    // 64x64 tiles of 8x8 blocks, both row-major
+};
+
+constexpr uint32_t LAYOUT_TILE = 64;
+constexpr uint32_t LAYOUT_BLOCK = 8;
+
+// Number of texels to allocate for a width x height target (tiled pads to whole tiles)
+inline size_t layoutSize(RenderLayout layout, uint32_t width, uint32_t height) {
+    if (layout == LAYOUT_LINEAR) return (size_t)width * height;
+    size_t tilesX = (width + LAYOUT_TILE - 1) / LAYOUT_TILE;
+    size_t tilesY = (height + LAYOUT_TILE - 1) / LAYOUT_TILE;
+    return tilesX * tilesY * LAYOUT_TILE * LAYOUT_TILE;
+}
+
+// Offset of texel (x, y); a tall, thin triangle stays within a few pages
+inline size_t layoutIndex(RenderLayout layout, uint32_t width, uint32_t x, uint32_t y) {
+    if (layout == LAYOUT_LINEAR) return (size_t)y * width + x;
+    size_t tilesX = (width + LAYOUT_TILE - 1) / LAYOUT_TILE;
+    size_t tile = (size_t)(y / LAYOUT_TILE) * tilesX + x / LAYOUT_TILE;
+    uint32_t block = ((y % LAYOUT_TILE) / LAYOUT_BLOCK) * (LAYOUT_TILE / LAYOUT_BLOCK) + (x % LAYOUT_TILE) / LAYOUT_BLOCK;
+    uint32_t inner = (y % LAYOUT_BLOCK) * LAYOUT_BLOCK + x % LAYOUT_BLOCK;
+    return tile * LAYOUT_TILE * LAYOUT_TILE + block * LAYOUT_BLOCK * LAYOUT_BLOCK + inner;
+}
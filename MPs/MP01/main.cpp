@@ -5,29 +5,64 @@
 #include <vector>
 #include <cmath>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 
 #include "rasterizer.h"
+#include "sequence.h"
+#include "stream.h"
+#include "meshopt.h"
+#include "prepass.h"
+#include "coordinator.h"
+#include "banded.h"
+#include "daemon.h"
 
 // Global Variables
 std::vector<Vertex> vertices;
 std::vector<Vec4> positions;
 std::vector<Vec4> colors;
-Image* img = nullptr;
+RenderTarget* img = nullptr;
+RenderLayout renderLayout = LAYOUT_TILED;
 std::string fileName;
 
 // Mode Setting
 bool depthEnabled = false;
-std::vector<std::vector<float>> depthBuffer; 
+DepthFormat depthFormat = DEPTH_FLOAT32;
+DepthBuffer depthBuffer;
 bool sRGBEnabled = false;
 bool hypEnabled  = false;
 std::vector<int> elements;
 std::vector<Vec2> texcoords;
+thread_local Rect scissor = {0, 0, 0, 0};
+Rect renderRegion = {0, 0, INT32_MAX, INT32_MAX};
+std::shared_ptr<const Texture> boundTexture;
+std::string pendingTexture;     // named by `texture`, bound at the next draw
+bool decalsEnabled = false;
+int imgOriginY = 0;
+int streamWorkers = 0;  // > 0: rasterize on worker threads while parsing
+bool optimizeEnabled = false;
+// Once a draw is optimized the loaded buffers are renumbered; vertexRemap maps
+// scene file vertex numbers to loaded ones (empty when they match)
+std::vector<int> vertexRemap;
+std::string outputPath;         // replaces the png file name when set (daemon)
+bool bufferCacheEnabled = false;
+
+// Parsed position, color and texcoord lines, reused when a later scene repeats one
+static std::unordered_map<std::string, std::vector<Vec4>> cachedVec4Lines;
+static std::unordered_map<std::string, std::vector<Vec2>> cachedVec2Lines;
+static size_t cachedBufferBytes = 0;
+// Depth buffers of other sizes, kept warm for later scenes
+static std::vector<DepthBuffer> depthPool;
 
 
 void parseFile(const std::string &filename);
+void parseStream(std::istream &infile);
 void initVertices(const std::vector<Vec4>& positions, const std::vector<Vec4>& colors, const std::vector<Vec2>& texcoords);
 void initDepthBuffer(int width, int height);
-void clearDepthBuffer();
+int remapIndex(int index);
+void resetVertexRemap();
+std::vector<int> optimizeElements(int count, int offset);
+void bindPendingTexture();
 
 void initVertices(const std::vector<Vec4>& positions, const std::vector<Vec4>& colors, const std::vector<Vec2>& texcoords) 
 {
@@ -38,16 +73,7 @@ void initVertices(const std::vector<Vec4>& positions, const std::vector<Vec4>& c
     {
         Vec4 pos = positions[i];
         Vec4 col = (i < colors.size()) ? colors[i] : Vec4();
-        if(depthEnabled)
-        {
-            initDepthBuffer((int)img->width(), (int)img->height());
-            if (pos.x >= 0 && pos.x < (int)img->width() && pos.y >= 0 && pos.y < (int)img->height()) 
-            {
-                depthBuffer[pos.y][pos.x] = colors[i].z;
-            }
-        }
-        //Vec2 tex = (i < 2) ? texcoords[i] : Vec2();
-        Vec2 tex;
+        Vec2 tex = (i < texcoords.size()) ? texcoords[i] : Vec2();
         // Create vertex and push into the vertices vector
         Vertex vertex(pos, col, tex);
         vertices.push_back(vertex);
@@ -56,13 +82,210 @@ void initVertices(const std::vector<Vec4>& positions, const std::vector<Vec4>& c
 }
 
 void initDepthBuffer(int width, int height) {
-    depthBuffer.resize(height, std::vector<float>(width, std::numeric_limits<float>::infinity()));
+    RenderLayout layout = img->layout();
+    if (!depthBuffer.matches(width, height, depthFormat, layout))
+    {
+        // Swap in a pooled buffer of this size, pooling the current one
+        auto found = std::find_if(depthPool.begin(), depthPool.end(), [&](const DepthBuffer &d) {
+            return d.matches(width, height, depthFormat, layout);
+        });
+        DepthBuffer pooled;
+        if (found != depthPool.end())
+        {
+            pooled = std::move(*found);
+            depthPool.erase(found);
+        }
+        if (depthBuffer.ready()) depthPool.push_back(std::move(depthBuffer));
+        if (depthPool.size() > DEPTH_BUFFER_POOL) depthPool.erase(depthPool.begin());
+        depthBuffer = std::move(pooled);
+    }
+    depthBuffer.init(width, height, depthFormat, layout);
+    depthBuffer.clear();
+}
+
+
+template <class T>
+static bool cachedBuffer(const std::unordered_map<std::string, std::vector<T>> &cache, const std::string &line,
+                         std::vector<T> &buffer)
+{
+    if (!bufferCacheEnabled) return false;
+    auto found = cache.find(line);
+    if (found == cache.end()) return false;
+    buffer = found->second;
+    return true;
+}
+
+template <class T>
+static void cacheBuffer(std::unordered_map<std::string, std::vector<T>> &cache, const std::string &line,
+                        const std::vector<T> &buffer)
+{
+    if (!bufferCacheEnabled) return;
+    size_t bytes = line.size() + buffer.size() * sizeof(T);
+    if (bytes > BUFFER_CACHE_BYTES) return;
+    if (cachedBufferBytes + bytes > BUFFER_CACHE_BYTES)
+    {
+        cachedVec4Lines.clear();
+        cachedVec2Lines.clear();
+        cachedBufferBytes = 0;
+    }
+    cache[line] = buffer;
+    cachedBufferBytes += bytes;
+}
+
+
+// Scene file vertex number -> loaded vertex number
+int remapIndex(int index)
+{
+    return (index >= 0 && index < (int)vertexRemap.size()) ? vertexRemap[index] : index;
+}
+
+// Return the loaded buffers to scene file numbering, e.g. before new positions arrive
+void resetVertexRemap()
+{
+    if (vertexRemap.empty()) return;
+    std::vector<int> inverse(vertexRemap.size());
+    for (size_t i = 0; i < vertexRemap.size(); ++i) inverse[vertexRemap[i]] = (int)i;
+    applyRemap(positions, inverse);
+    applyRemap(colors, inverse);
+    applyRemap(texcoords, inverse);
+    for (int &e : elements) if (e >= 0 && e < (int)inverse.size()) e = inverse[e];
+    vertexRemap.clear();
+}
+
+// Reorder a drawElementsTriangles range for the vertex cache, then renumber vertices.
+// Other draws may share the elements, so the range in its original triangle
+// order (renumbered) is returned, to be put back once this draw is issued;
+// empty if the order was kept.
+std::vector<int> optimizeElements(int count, int offset)
+{
+    if (offset < 0 || count < 3 || offset + count > (int)elements.size()) return {};
+    int *range = &elements[offset];
+    std::vector<int> original(range, range + count);
+    float before = computeACMR(range, count);
+    float after = before;
+    // Overlapping triangles keep their order even with depth on: at equal
+    // depth the first one drawn wins
+    std::vector<float> xy;
+    for (const Vec4 &p : positions) xy.insert(xy.end(), {p.x, p.y});
+    bool reordered = false;
+    if (trianglesOverlap(range, count, xy))
+        std::cerr << "Elements " << offset << ":" << count << " overlap, keeping their order." << std::endl;
+    else
+    {
+        optimizeTriangleOrder(range, count);
+        after = computeACMR(range, count);
+        reordered = after < before;
+        if (!reordered) std::copy(original.begin(), original.end(), range);     // no better, keep the order
+    }
+
+    // Renumber in fetch order of this draw and keep every buffer consistent
+    int vertexCount = std::max((int)positions.size(), vertexCountOf(range, count));
+    std::vector<int> remap = fetchOrderRemap(range, count, vertexCount);
+    applyRemap(positions, remap);
+    applyRemap(colors, remap);
+    applyRemap(texcoords, remap);
+    for (int &e : elements) if (e >= 0 && e < vertexCount) e = remap[e];
+    for (int &e : original) if (e >= 0 && e < vertexCount) e = remap[e];
+    for (int i = (int)vertexRemap.size(); i < vertexCount; ++i) vertexRemap.push_back(i);
+    for (int &v : vertexRemap) if (v < vertexCount) v = remap[v];
+
+    std::cout << "Optimized elements " << offset << ":" << count << " ACMR " << before << " -> "
+              << (reordered ? after : before) << std::endl;
+    if (!reordered) original.clear();
+    return original;
+}
+
+
+// The decode started when `texture` was parsed; wait for it only now, so it
+// overlaps with parsing and with streamed draws still rasterizing
+void bindPendingTexture()
+{
+    if (pendingTexture.empty()) return;
+    if (streamActive()) drainStream();
+    boundTexture = acquireTexture(pendingTexture);
+    pendingTexture.clear();
+}
+
+
+// Back to the state of a fresh process, keeping the caches and pools warm
+void resetScene()
+{
+    vertices.clear();
+    positions.clear();
+    colors.clear();
+    elements.clear();
+    texcoords.clear();
+    releaseRenderTarget(img);
+    img = nullptr;
+    renderLayout = LAYOUT_TILED;
+    fileName.clear();
+    depthEnabled = false;
+    depthFormat = DEPTH_FLOAT32;
+    sRGBEnabled = false;
+    hypEnabled = false;
+    decalsEnabled = false;
+    scissor = {0, 0, 0, 0};
+    renderRegion = {0, 0, INT32_MAX, INT32_MAX};
+    boundTexture.reset();
+    pendingTexture.clear();
+    imgOriginY = 0;
+    optimizeEnabled = false;
+    vertexRemap.clear();
+    depthPass = PASS_NORMAL;
+    resetSequence();
+    resetPrepass();
+    resetBanded();
+}
+
+
+// Parse, then finish whatever rendering the scene deferred
+void renderScene(std::istream &infile)
+{
+    parseStream(infile);
+    if (streamActive()) stopStream();
+    if (prepassEnabled && !sequenceEnabled && img) renderPrepass();
+    if (bandedActive()) renderBanded(fileName);
+}
+
+
+// Write the rendered image to its png file and recycle the render target
+bool saveScene()
+{
+    bool saved = true;
+    // Sequence mode: draws changed after the last frame go to the png file name
+    if (img && sequenceEnabled)
+    {
+        if (sequencePending()) renderFrame(fileName);
+    }
+    else if (bandedActive())
+    {
+        // Banded mode: rows were written to the file as each band finished
+    }
+    else if(img)
+    {
+        std::cout << "saving img to ... " << fileName << std::endl;;
+        img->save(fileName.c_str());
+    }
+    else
+    {
+        std::cout << "Error: Can't save image." << std::endl;
+        saved = false;
+    }
+    releaseRenderTarget(img);
+    img = nullptr;
+    return saved;
 }
 
 
 void parseFile(const std::string &filename) 
 {
     std::ifstream infile(filename);
+    renderScene(infile);
+}
+
+
+void parseStream(std::istream &infile) 
+{
     std::string inputLine;
     int width{1}, height{1};
     
@@ -71,16 +294,70 @@ void parseFile(const std::string &filename)
         std::istringstream iss(inputLine);
         std::string keyword;
         iss >> keyword;
+        int updateIndex = -1;
+        if (keyword == "update")
+        {
+            // update <draw> <draw command>: replace a recorded draw (sequence mode)
+            iss >> updateIndex >> keyword;
+        }
+        // Streaming mode: queued draws finish under the old state before it changes
+        if (streamActive() && (keyword == "depth" || keyword == "sRGB" || keyword == "hyp" || keyword == "texcoord"
+                               || keyword == "decals"))
+        {
+            drainStream();
+        }
+
         if (keyword == "png")
         {
             iss >> width >> height >> fileName;
-            img = new Image(width, height);
+            if (!outputPath.empty()) fileName = outputPath;
+            if (memoryBudget > 0)
+            {
+                // Banded: targets are allocated per band when the scene ends
+                startBanded(width, height);
+            }
+            else
+            {
+                // Only the render region's rows are allocated; img row 0 is image row imgOriginY
+                int y0 = std::max(0, std::min(height, renderRegion.y0));
+                int y1 = std::max(y0, std::min(height, renderRegion.y1));
+                releaseRenderTarget(img);
+                img = acquireRenderTarget(width, y1 - y0, renderLayout);
+                imgOriginY = y0;
+                scissor = {std::max(0, renderRegion.x0), y0, std::min(width, renderRegion.x1), y1};
+                if (depthEnabled) initDepthBuffer(width, y1 - y0);
+                if (streamWorkers > 0) startStream(streamWorkers);
+            }
             std::cout << "PNG" << width << "x" << height<< std::endl;    //Debugging
         }
         // Mode Setting 
+        else if (keyword == "budget")
+        {
+            // budget <MiB>, before png: render in bands that fit it
+            double mib = 0;
+            iss >> mib;
+            memoryBudget = (size_t)(std::max(0.0, mib) * (1 << 20));
+            std::cout << "Memory budget " << memoryBudget << " bytes." << std::endl;
+        }
+        else if (keyword == "layout")
+        {
+            // layout [linear | tiled], before png
+            std::string layout;
+            iss >> layout;
+            if (layout == "linear") renderLayout = LAYOUT_LINEAR;
+            else if (layout == "tiled") renderLayout = LAYOUT_TILED;
+            else std::cerr << "Unknown layout " << layout << ", ignored." << std::endl;
+        }
         else if (keyword == "depth") 
         {
+            // depth [float32 | unorm24 | unorm16]
+            std::string format;
+            if (iss >> format && !parseDepthFormat(format, depthFormat))
+            {
+                std::cerr << "Unknown depth format " << format << ", using float32." << std::endl;
+            }
             depthEnabled = true;
+            if (img) initDepthBuffer((int)img->width(), (int)img->height());
             std::cout << "Depth buffer and tests enabled." << std::endl;
         } 
         else if (keyword == "sRGB") 
@@ -94,73 +371,122 @@ void parseFile(const std::string &filename)
             std::cout << "Hyperbolic interpolation enabled." << std::endl;
 
         } 
+        else if (keyword == "decals")
+        {
+            decalsEnabled = true;
+            std::cout << "Decals enabled." << std::endl;
+        }
+        else if (keyword == "texture")
+        {
+            iss >> pendingTexture;
+            prefetchTexture(pendingTexture);
+            std::cout << "Texture " << pendingTexture << std::endl;
+        }
+        else if (keyword == "prepass")
+        {
+            prepassEnabled = true;
+            std::cout << "Depth pre-pass enabled." << std::endl;
+        }
+        else if (keyword == "optimize")
+        {
+            optimizeEnabled = true;
+            std::cout << "Index buffer optimization enabled." << std::endl;
+        }
+        else if (keyword == "sequence")
+        {
+            sequenceEnabled = true;
+            std::cout << "Sequence mode enabled." << std::endl;
+        }
+        else if (keyword == "frame")
+        {
+            std::string frameName;
+            iss >> frameName;
+            if (sequenceEnabled && img) renderFrame(frameName);
+        }
         // Buffer provision
         else if (keyword == "position") 
         {
+            resetVertexRemap();
             vertices.clear();
             positions.clear();
 
-            int size;
-            iss >> size;
-            float num;
-            std::vector<float> positionData;
-            while (iss >> num) 
-            {
-                positionData.push_back(num);
-            }
-            // Get the positions
-            for (size_t i = 0; i < positionData.size(); i += size) 
+            // the viewport transform depends on the image size
+            std::string cacheKey = bufferCacheEnabled ? std::to_string(width) + "x" + std::to_string(height) + " " + inputLine : "";
+            if (!cachedBuffer(cachedVec4Lines, cacheKey, positions))
             {
-                Vec4 pos;
-                pos.x = positionData[i];
-                pos.y = (size > 1) ? positionData[i + 1] : 0;
-                pos.z = (size > 2) ? positionData[i + 2] : 0;
-                pos.w = (size > 3) ? positionData[i + 3] : 1; 
-
-                // transformation
-                pos.x = ((pos.x / pos.w) + 1) * (width / 2.0f);
-                pos.y = ((pos.y / pos.w) + 1) * (height / 2.0f);
-                positions.push_back(pos);
-                std::cout << "t-pos: " << pos.x << " "<< pos.y<< " " << pos.z << " "<< pos.w<< std::endl; // Debugging
+                int size;
+                iss >> size;
+                float num;
+                std::vector<float> positionData;
+                while (iss >> num) 
+                {
+                    positionData.push_back(num);
+                }
+                // Get the positions
+                for (size_t i = 0; i < positionData.size(); i += size) 
+                {
+                    Vec4 pos;
+                    pos.x = positionData[i];
+                    pos.y = (size > 1) ? positionData[i + 1] : 0;
+                    pos.z = (size > 2) ? positionData[i + 2] : 0;
+                    pos.w = (size > 3) ? positionData[i + 3] : 1; 
+
+                    // transformation
+                    pos.x = ((pos.x / pos.w) + 1) * (width / 2.0f);
+                    pos.y = ((pos.y / pos.w) + 1) * (height / 2.0f);
+                    positions.push_back(pos);
+                    std::cout << "t-pos: " << pos.x << " "<< pos.y<< " " << pos.z << " "<< pos.w<< std::endl; // Debugging
+                }
+                std::cout << "Position" << size << std::endl;    //Debugging
+                cacheBuffer(cachedVec4Lines, cacheKey, positions);
             }
-            std::cout << "Position" << size << std::endl;    //Debugging
         } 
         else if (keyword == "color") {
             colors.clear();
-            int size;
-            iss >> size;
-            float num;
-            while (iss >> num) 
+            if (!cachedBuffer(cachedVec4Lines, inputLine, colors))
             {
-                Vec4 col;
-                col.x = num;
-                if (size > 1) iss >> col.y;
-                if (size > 2) iss >> col.z;
-                if (size > 3) iss >> col.w;
-                colors.push_back(col);
-                std::cout << "col: " << col.x << " "<< col.y<< " " << col.z << " "<< col.w<< std::endl;  // Debugging
+                int size;
+                iss >> size;
+                float num;
+                while (iss >> num) 
+                {
+                    Vec4 col;
+                    col.x = num;
+                    if (size > 1) iss >> col.y;
+                    if (size > 2) iss >> col.z;
+                    if (size > 3) iss >> col.w;
+                    colors.push_back(col);
+                    std::cout << "col: " << col.x << " "<< col.y<< " " << col.z << " "<< col.w<< std::endl;  // Debugging
 
+                }
+                cacheBuffer(cachedVec4Lines, inputLine, colors);
             }
+            applyRemap(colors, vertexRemap);
         }
         else if (keyword == "texcoord")
         {
             texcoords.clear();
-            int size;
-            iss >> size;
-            float s, t;
-            while (iss >> s >> t) 
+            if (!cachedBuffer(cachedVec2Lines, inputLine, texcoords))
             {
-                texcoords.push_back(Vec2(s, t));
-                std::cout << "texcoords: " << s << " "<< t << std::endl;
+                int size;
+                iss >> size;
+                float s, t;
+                while (iss >> s >> t) 
+                {
+                    texcoords.push_back(Vec2(s, t));
+                    std::cout << "texcoords: " << s << " "<< t << std::endl;
 
+                }
+                cacheBuffer(cachedVec2Lines, inputLine, texcoords);
             }
+            applyRemap(texcoords, vertexRemap);
         }
         else if (keyword == "elements") 
         {
             int elementIdx;
             while (iss >> elementIdx) 
             {
-                elements.push_back(elementIdx);
+                elements.push_back(remapIndex(elementIdx));
             }
         }
         else if (keyword == "drawArraysTriangles")
@@ -168,46 +494,107 @@ void parseFile(const std::string &filename)
             int first, count;
             iss >> first >> count;
             std::cout << "DrawArraysTriangles" << first << ":"<< count <<  std::endl;    // Debugging
-            initVertices(positions, colors, texcoords);
-            drawArraysTriangles(first, count);
+            resetVertexRemap();     // first and count are in scene file numbering
+            bindPendingTexture();
+            bool streamed = streamActive() && !bandedActive() && !sequenceEnabled && !prepassEnabled;
+            if (!streamed) initVertices(positions, colors, texcoords);     // streaming reads the buffers per batch
+            if (bandedActive()) recordBandedDraw(arraysTriangles(first, count));
+            else if (sequenceEnabled) recordDraw(updateIndex, arraysTriangles(first, count));
+            else if (prepassEnabled) recordPrepassDraw(arraysTriangles(first, count));
+            else if (streamed) streamArrays(first, count);
+            else drawArraysTriangles(first, count);
         } 
         else if (keyword == "drawElementsTriangles") 
         {
             int count, offset;
             iss >> count >> offset;
             std::cout << "drawElementsTriangles" << count << ":"<< offset <<  std::endl;    // Debugging
-            initVertices(positions, colors, texcoords);
-            drawElementsTriangles(count, offset);
+            std::vector<int> original;
+            if (optimizeEnabled) original = optimizeElements(count, offset);
+            bindPendingTexture();
+            bool streamed = streamActive() && !bandedActive() && !sequenceEnabled && !prepassEnabled;
+            if (!streamed) initVertices(positions, colors, texcoords);     // streaming reads the buffers per batch
+            if (bandedActive()) recordBandedDraw(elementsTriangles(count, offset));
+            else if (sequenceEnabled) recordDraw(updateIndex, elementsTriangles(count, offset));
+            else if (prepassEnabled) recordPrepassDraw(elementsTriangles(count, offset));
+            else if (streamed) streamElements(count, offset);
+            else drawElementsTriangles(count, offset);
+            // Every mode has copied the triangles by now; later draws see the scene's order
+            std::copy(original.begin(), original.end(), elements.begin() + offset);
         } 
     }
 }
 
 
+// rasterbench links the scene loader above and brings its own main()
+#ifndef RASTER_BENCH
 int main(int argc, char *argv[])
 {
-    std::string inputFile = argv[1];
-	std::ifstream infile(inputFile);
-    std::cout << "Opening File..." << std::endl;    // Debugging
-	if (!infile)
-	{
-		std::cerr << "Error opening the file! Terminating the program" << std::endl;
-		exit(1);
-	}
-    //Image* img = nullptr;
-
-    parseFile(inputFile);
-
-    if(img)
+    // No file or "-": stream the scene from stdin, rasterizing while parsing
+    std::string inputFile = (argc > 1) ? argv[1] : "-";
+    bool coordinated = false;
+    if (inputFile == "--daemon" && argc > 2)
     {
-        std::cout << "saving img to ... " << fileName << std::endl;;
-        img->save(fileName.c_str());
-        delete img;
-        img = nullptr;
+        int jobs = (argc > 3) ? std::atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+        return runDaemon(argv[2], std::max(1, jobs));
     }
-    else
+    if (inputFile == "--processes" && argc > 3)
     {
-        std::cout << "Error: Can't save image." << std::endl;
+        // Sort-first: worker processes render regions, composited here
+        coordinated = coordinateScene(std::atoi(argv[2]), argv[3]);
+        if (!coordinated)
+        {
+            delete img;
+            img = nullptr;
+            inputFile = argv[3];
+        }
+    }
+    if (!coordinated && inputFile == "-")
+    {
+        streamWorkers = (argc > 2) ? std::atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+        if (streamWorkers < 1) streamWorkers = 1;
+        renderScene(std::cin);
+    }
+    else if (!coordinated)
+    {
+	    std::ifstream infile(inputFile);
+        std::cout << "Opening File..." << std::endl;    // Debugging
+	    if (!infile)
+	    {
+		    std::cerr << "Error opening the file! Terminating the program" << std::endl;
+		    exit(1);
+	    }
+        //Image* img = nullptr;
+
+        parseFile(inputFile);
+    }
+
+    // The workers' counters stay in their processes
+    if (!coordinated)
+    {
+        flushRasterStats();
+        RasterStats raster = totalRasterStats();
+        std::cout << "Fragments: " << raster.fragments << " rasterized, " << raster.shaded << " shaded" << std::endl;
+    }
+
+    TextureCacheStats textures = textureCacheStats();
+    if (textures.misses > 0)
+    {
+        std::cout << "Textures: " << textures.misses << " decoded, " << textures.hits << " cache hits, "
+                  << textures.bytes << " bytes cached" << std::endl;
+    }
+
+    if (depthEnabled)
+    {
+        DepthBuffer::flushStats();
+        DepthStats stats = DepthBuffer::totalStats();
+        std::cout << "Depth (" << depthBuffer.formatName() << "): " << stats.tests << " tests, "
+                  << stats.writes << " writes, "
+                  << (stats.tests + stats.writes) * depthBuffer.bytesPerTexel() + (stats.flagBits + 7) / 8
+                  << " bytes" << std::endl;
     }
 
+    saveScene();
     return 0;
 }
+#endif
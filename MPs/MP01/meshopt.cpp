@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "meshopt.h"
+
+using namespace std;
+
+int vertexCountOf(const int *indices, size_t count)
+{
+    int n = 0;
+    for (size_t i = 0; i < count; ++i) n = std::max(n, indices[i] + 1);
+    return n;
+}
+
+float computeACMR(const int *indices, size_t count, int cacheSize)
+{
+    size_t triangles = count / 3;
+    if (triangles == 0) return 0;
+    // FIFO cache: a vertex is resident if it was inserted within the last cacheSize misses
+    std::vector<long> insertedAt(vertexCountOf(indices, count), -1);
+    long misses = 0;
+    for (size_t i = 0; i < triangles * 3; ++i)
+    {
+        int v = indices[i];
+        if (v < 0) continue;
+        if (insertedAt[v] < 0 || misses - insertedAt[v] >= cacheSize)
+        {
+            insertedAt[v] = misses;
+            ++misses;
+        }
+    }
+    return (float)misses / triangles;
+}
+
+
+void optimizeTriangleOrder(int *indices, size_t count, int cacheSize)
+{
+    /*
+    Tipsify:
+    1: Build vertex -> triangle adjacency and live triangle counts
+    2: Fan around vertex f, emitting its unemitted triangles
+    3: Next f: the candidate that stays in cache and has the fewest live
+       triangles left, else the most recent dead end, else the next live vertex
+    */
+    size_t triangles = count / 3;
+    int vertexCount = vertexCountOf(indices, triangles * 3);
+    if (triangles < 2 || vertexCount == 0) return;
+    for (size_t i = 0; i < triangles * 3; ++i) if (indices[i] < 0) return;
+
+    // Step 1
+    std::vector<int> live(vertexCount, 0), start(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangles * 3; ++i) ++live[indices[i]];
+    for (int v = 0; v < vertexCount; ++v) start[v + 1] = start[v] + live[v];
+    std::vector<int> adjacency(triangles * 3), fill(start.begin(), start.end() - 1);
+    for (size_t t = 0; t < triangles; ++t)
+        for (int k = 0; k < 3; ++k) adjacency[fill[indices[t * 3 + k]]++] = (int)t;
+
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<char> emitted(triangles, 0);
+    std::vector<int> deadEnd, candidates, output;
+    output.reserve(triangles * 3);
+    int time = cacheSize + 1;
+    int cursor = 0;
+    int f = indices[0];
+
+    while (f >= 0)
+    {
+        // Step 2
+        candidates.clear();
+        for (int a = start[f]; a < start[f + 1]; ++a)
+        {
+            int t = adjacency[a];
+            if (emitted[t]) continue;
+            for (int k = 0; k < 3; ++k)
+            {
+                int v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+            }
+            emitted[t] = 1;
+        }
+
+        // Step 3
+        int best = -1, bestPriority = -1;
+        for (int v : candidates)
+        {
+            if (live[v] <= 0) continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize) priority = time - cacheTime[v];
+            if (priority > bestPriority) { best = v; bestPriority = priority; }
+        }
+        while (best < 0 && !deadEnd.empty())
+        {
+            int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0) best = v;
+        }
+        while (best < 0 && cursor < vertexCount)
+        {
+            if (live[cursor] > 0) best = cursor;
+            ++cursor;
+        }
+        f = best;
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+
+bool trianglesOverlap(const int *indices, size_t count, const std::vector<float> &xy)
+{
+    // Sweep the boxes in x order; spans are half-open, so boxes that only
+    // touch share no sample
+    struct Box { float x0, y0, x1, y1; };
+    std::vector<Box> boxes;
+    int vertexCount = (int)(xy.size() / 2);
+    for (size_t t = 0; t + 2 < count; t += 3)
+    {
+        Box b = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+        for (size_t k = t; k < t + 3; ++k)
+        {
+            int v = indices[k];
+            if (v < 0 || v >= vertexCount) return true;
+            float x = xy[2 * v], y = xy[2 * v + 1];
+            if (!std::isfinite(x) || !std::isfinite(y)) return true;
+            b = {std::min(b.x0, x), std::min(b.y0, y), std::max(b.x1, x), std::max(b.y1, y)};
+        }
+        boxes.push_back(b);
+    }
+    std::sort(boxes.begin(), boxes.end(), [](const Box &a, const Box &b) { return a.x0 < b.x0; });
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        for (size_t j = i + 1; j < boxes.size() && boxes[j].x0 < boxes[i].x1; ++j)
+        {
+            if (boxes[j].y0 < boxes[i].y1 && boxes[i].y0 < boxes[j].y1) return true;
+        }
+    }
+    return false;
+}
+
+
+std::vector<int> fetchOrderRemap(const int *indices, size_t count, int vertexCount)
+{
+    std::vector<int> remap(vertexCount, -1);
+    int next = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        int v = indices[i];
+        if (v >= 0 && v < vertexCount && remap[v] < 0) remap[v] = next++;
+    }
+    for (int v = 0; v < vertexCount; ++v) if (remap[v] < 0) remap[v] = next++;
+    return remap;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/*
+Index buffer optimization for vertex-cache reuse and fetch locality.
+
+optimizeTriangleOrder() reorders triangles with Tipsify (Sander, Nehab and
+Barczak 2007): it fans around recently used vertices, so consecutive
+triangles share vertices and stay close on screen. fetchOrderRemap() then
+numbers vertices in first-use order so attribute fetches walk forward.
+
+The order decides a pixel covered by two triangles: without a depth test
+the last one drawn wins, and at equal depth the first one does. Callers
+therefore only reorder when trianglesOverlap() is false, and keep the
+original order if the ACMR does not improve.
+*/
+
+// Post-transform cache size assumed by the optimizer and by ACMR
+constexpr int VERTEX_CACHE_SIZE = 16;
+
+// One more than the largest index
+int vertexCountOf(const int *indices, size_t count);
+
+// Average cache miss ratio: FIFO cache misses per triangle (0.5 .. 3)
+float computeACMR(const int *indices, size_t count, int cacheSize = VERTEX_CACHE_SIZE);
+
+void optimizeTriangleOrder(int *indices, size_t count, int cacheSize = VERTEX_CACHE_SIZE);
+
+// True if the screen bounding boxes of two triangles overlap, i.e. their
+// draw order may decide a pixel. xy holds x, y per vertex; an index outside
+// it or a non-finite position counts as an overlap.
+bool trianglesOverlap(const int *indices, size_t count, const std::vector<float> &xy);
+
+// remap[old] = new, in first-use order; unused vertices keep their order at the end
+std::vector<int> fetchOrderRemap(const int *indices, size_t count, int vertexCount);
+
+// Move buffer[i] to buffer[remap[i]]; a short buffer is padded with T() first
+template <class T>
+void applyRemap(std::vector<T> &buffer, const std::vector<int> &remap)
+{
+    if (buffer.empty()) return;
+    if (buffer.size() < remap.size()) buffer.resize(remap.size(), T());
+    std::vector<T> old(buffer.begin(), buffer.begin() + remap.size());
+    for (size_t i = 0; i < remap.size(); ++i) buffer[remap[i]] = old[i];
+}
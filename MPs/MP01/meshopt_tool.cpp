@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "meshopt.h"
+
+/*
+Offline index buffer optimizer for scene files.
+
+    ./meshopt in.txt out.txt
+
+Triangles inside every drawElementsTriangles range are reordered for the
+vertex cache, and each `elements` line keeps its length. A range is only
+reordered if no two of its triangles overlap on screen (even with depth on,
+equal depths keep the first triangle drawn), no other draw shares any of
+its elements, and the ACMR improves. Vertices are also
+renumbered in fetch order (rewriting the position, color and texcoord
+lines) when that is unambiguous: the scene has a single position buffer,
+at most one color and texcoord buffer, and no drawArraysTriangles.
+*/
+
+struct Line {
+    std::string keyword;
+    std::vector<std::string> tokens;    // everything after the keyword
+};
+
+static std::string join(const Line &line)
+{
+    std::string out = line.keyword;
+    for (const std::string &t : line.tokens) out += " " + t;
+    return out;
+}
+
+// Number of vertices in a "<keyword> <size> values..." line
+static size_t attributeCount(const Line &line)
+{
+    if (line.tokens.empty()) return 0;
+    int size = std::max(1, std::stoi(line.tokens[0]));
+    return (line.tokens.size() - 1) / size;
+}
+
+// x/w, y/w of every vertex of a position line; the viewport transform keeps overlaps
+static std::vector<float> screenXY(const Line &line)
+{
+    std::vector<float> xy;
+    if (line.tokens.empty()) return xy;
+    int size = std::max(1, std::stoi(line.tokens[0]));
+    for (size_t i = 1; i + size <= line.tokens.size(); i += size)
+    {
+        float x = std::stof(line.tokens[i]);
+        float y = (size > 1) ? std::stof(line.tokens[i + 1]) : 0;
+        float w = (size > 3) ? std::stof(line.tokens[i + 3]) : 1;
+        xy.insert(xy.end(), {x / w, y / w});
+    }
+    return xy;
+}
+
+// Permute the per-vertex groups of a "<keyword> <size> values..." line
+static void remapAttributeLine(Line &line, const std::vector<int> &remap)
+{
+    int size = std::max(1, std::stoi(line.tokens[0]));
+    std::vector<std::string> old(line.tokens.begin() + 1, line.tokens.end());
+    for (size_t v = 0; v < remap.size(); ++v)
+        for (int k = 0; k < size; ++k)
+            line.tokens[1 + remap[v] * size + k] = old[v * size + k];
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " in.txt out.txt" << std::endl;
+        return 1;
+    }
+    std::ifstream infile(argv[1]);
+    if (!infile)
+    {
+        std::cerr << "Error opening " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::vector<Line> lines;
+    std::string inputLine;
+    while (std::getline(infile, inputLine))
+    {
+        std::istringstream iss(inputLine);
+        Line line;
+        iss >> line.keyword;
+        std::string token;
+        while (iss >> token) line.tokens.push_back(token);
+        lines.push_back(line);
+    }
+
+    // [offset, offset + count) of every drawElementsTriangles, to find shared elements
+    std::vector<std::pair<int, int>> ranges;
+    for (const Line &line : lines)
+    {
+        if (line.keyword == "drawElementsTriangles" && line.tokens.size() >= 2)
+        {
+            int count = std::stoi(line.tokens[0]), offset = std::stoi(line.tokens[1]);
+            ranges.push_back({offset, offset + count});
+        }
+    }
+    size_t draw = 0;
+
+    // Elements accumulate across lines, as in the loader
+    std::vector<int> elements;
+    std::vector<size_t> elementLines;
+    int positionLines = 0, colorLines = 0, texcoordLines = 0, arrayDraws = 0;
+    int positionLine = -1, colorLine = -1, texcoordLine = -1;
+    size_t vertexCount = 0;
+    std::vector<float> xy;          // of the current position line
+    float before = 0, after = 0;
+    int draws = 0;
+
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        Line &line = lines[i];
+        if (line.keyword == "position")
+        {
+            ++positionLines;
+            positionLine = (int)i;
+            vertexCount = attributeCount(line);
+            xy = screenXY(line);
+        }
+        else if (line.keyword == "color") { ++colorLines; colorLine = (int)i; }
+        else if (line.keyword == "texcoord") { ++texcoordLines; texcoordLine = (int)i; }
+        else if (line.keyword == "drawArraysTriangles") ++arrayDraws;
+        else if (line.keyword == "elements")
+        {
+            elementLines.push_back(i);
+            for (const std::string &t : line.tokens) elements.push_back(std::stoi(t));
+        }
+        else if (line.keyword == "drawElementsTriangles" && line.tokens.size() >= 2)
+        {
+            int count = std::stoi(line.tokens[0]), offset = std::stoi(line.tokens[1]);
+            size_t self = draw++;
+            if (offset < 0 || count < 3 || offset + count > (int)elements.size()) continue;
+            bool shared = false;
+            for (size_t j = 0; j < ranges.size(); ++j)
+                if (j != self && ranges[j].first < offset + count && offset < ranges[j].second) shared = true;
+            int *range = &elements[offset];
+            float b = computeACMR(range, count), a = b;
+            if (shared)
+                std::cerr << "drawElementsTriangles " << count << " " << offset
+                          << ": elements shared with another draw, order kept" << std::endl;
+            else if (trianglesOverlap(range, count, xy))
+                std::cerr << "drawElementsTriangles " << count << " " << offset
+                          << ": overlapping triangles, order kept" << std::endl;
+            else
+            {
+                std::vector<int> original(range, range + count);
+                optimizeTriangleOrder(range, count);
+                a = computeACMR(range, count);
+                if (!(a < b)) { std::copy(original.begin(), original.end(), range); a = b; }
+            }
+            std::cout << "drawElementsTriangles " << count << " " << offset << ": ACMR " << b << " -> " << a << std::endl;
+            before += b;
+            after += a;
+            ++draws;
+        }
+    }
+
+    bool renumber = positionLines == 1 && colorLines <= 1 && texcoordLines <= 1 && arrayDraws == 0
+                    && !elements.empty() && vertexCountOf(elements.data(), elements.size()) <= (int)vertexCount
+                    && (colorLine < 0 || attributeCount(lines[colorLine]) == vertexCount)
+                    && (texcoordLine < 0 || attributeCount(lines[texcoordLine]) == vertexCount);
+    if (renumber)
+    {
+        std::vector<int> remap = fetchOrderRemap(elements.data(), elements.size(), (int)vertexCount);
+        remapAttributeLine(lines[positionLine], remap);
+        if (colorLine >= 0) remapAttributeLine(lines[colorLine], remap);
+        if (texcoordLine >= 0) remapAttributeLine(lines[texcoordLine], remap);
+        for (int &e : elements) if (e >= 0) e = remap[e];
+    }
+
+    // Write the elements back, each line keeping its length
+    size_t next = 0;
+    for (size_t l : elementLines)
+    {
+        for (std::string &t : lines[l].tokens) t = std::to_string(elements[next++]);
+    }
+
+    std::ofstream outfile(argv[2]);
+    for (const Line &line : lines) outfile << join(line) << "\n";
+
+    if (draws > 0) std::cout << "Mean ACMR " << before / draws << " -> " << after / draws << std::endl;
+    std::cout << (renumber ? "Vertices renumbered in fetch order." : "Vertices left in place.") << std::endl;
+    return 0;
+}
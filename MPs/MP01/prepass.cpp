@@ -0,0 +1,35 @@
+#include <iostream>
+#include <vector>
+#include "prepass.h"
+
+using namespace std;
+
+bool prepassEnabled = false;
+
+static std::vector<RecordedDraw> draws;
+
+
+void recordPrepassDraw(const std::vector<Vertex> &triangles)
+{
+    draws.push_back({triangles, boundTexture});
+}
+
+static void drawAll()
+{
+    replayDraws(draws, [](size_t, const RecordedDraw &d) {
+        for (size_t t = 0; t < d.triangleCount(); ++t) d.draw(t);
+    });
+}
+
+void resetPrepass()
+{
+    prepassEnabled = false;
+    draws.clear();
+}
+
+void renderPrepass()
+{
+    if (!depthEnabled) std::cerr << "Depth pre-pass needs depth, drawing in one pass." << std::endl;
+    drawWithPrepass(drawAll);
+    draws.clear();
+}
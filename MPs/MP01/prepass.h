@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include "rasterizer.h"
+
+/*
+Depth pre-pass: draws are recorded and replayed at the end of the scene in
+two passes. The first is position-only and writes depth without color; the
+second shades only fragments whose depth equals the stored one, so each
+pixel is shaded once however much overdraw the scene has.
+
+Needs `depth`. Mode settings apply to the whole scene, as they are read
+when the draws are replayed; each draw keeps the texture bound when it was
+recorded.
+*/
+
+extern bool prepassEnabled;
+
+// Run draw() as the two passes, depth only and then shade-equal; once as a
+// normal pass without depth
+template <class F>
+void drawWithPrepass(F draw)
+{
+    if (!depthEnabled)
+    {
+        draw();
+        return;
+    }
+    depthPass = PASS_DEPTH_ONLY;
+    draw();
+    depthPass = PASS_SHADE_EQUAL;
+    depthBuffer.beginEqualPass();
+    draw();
+    depthBuffer.endEqualPass();
+    depthPass = PASS_NORMAL;
+}
+
+void recordPrepassDraw(const std::vector<Vertex> &triangles);
+void resetPrepass();
+void renderPrepass();
@@ -0,0 +1,118 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+Client for the render daemon (see daemon.h).
+
+    ./rasterclient socket scene.txt             # the daemon writes the png the scene names
+    ./rasterclient socket scene.txt out.png     # the png comes back inline, saved as out.png
+    ./rasterclient socket --stats
+
+The scene's directory is sent along, so its textures and output resolve as
+if the scene were rendered there.
+*/
+
+static int connectTo(const char *path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    if (fd < 0 || connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        std::perror(path);
+        std::exit(1);
+    }
+    return fd;
+}
+
+// Send the request, then read the whole reply
+static std::string request(const char *socketPath, const std::string &text)
+{
+    int fd = connectTo(socketPath);
+    for (size_t sent = 0; sent < text.size();)
+    {
+        ssize_t n = write(fd, text.data() + sent, text.size() - sent);
+        if (n <= 0)
+        {
+            std::perror("write");
+            std::exit(1);
+        }
+        sent += n;
+    }
+    shutdown(fd, SHUT_WR);
+
+    std::string reply;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) reply.append(buffer, n);
+    close(fd);
+    return reply;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " socket scene.txt [out.png] | socket --stats" << std::endl;
+        return 1;
+    }
+    if (std::string(argv[2]) == "--stats")
+    {
+        std::cout << request(argv[1], "stats\n");
+        return 0;
+    }
+
+    std::ifstream infile(argv[2]);
+    if (!infile)
+    {
+        std::cerr << "Error opening " << argv[2] << std::endl;
+        return 1;
+    }
+    std::stringstream scene;
+    scene << infile.rdbuf();
+
+    std::string scenePath = argv[2];
+    size_t slash = scenePath.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "." : scenePath.substr(0, slash);
+    char *absolute = realpath(dir.c_str(), nullptr);
+    if (absolute)
+    {
+        dir = absolute;
+        std::free(absolute);
+    }
+
+    bool inline_ = argc > 3;
+    auto start = std::chrono::steady_clock::now();
+    std::string reply = request(argv[1], std::string("render ") + (inline_ ? "inline " : "file ") + dir + "\n" + scene.str());
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t lineEnd = reply.find('\n');
+    std::string status = reply.substr(0, lineEnd);
+    if (status.compare(0, 3, "ok ") != 0)
+    {
+        std::cerr << argv[2] << ": " << (status.empty() ? "no reply" : status) << std::endl;
+        return 1;
+    }
+    if (inline_)
+    {
+        size_t size = std::strtoull(status.c_str() + 3, nullptr, 10);
+        if (lineEnd == std::string::npos || reply.size() - lineEnd - 1 != size)
+        {
+            std::cerr << argv[2] << ": truncated reply" << std::endl;
+            return 1;
+        }
+        std::ofstream(argv[3], std::ios::binary).write(reply.data() + lineEnd + 1, size);
+        std::cout << argv[3] << " (" << size << " bytes, " << ms << " ms)" << std::endl;
+    }
+    else std::cout << status.substr(3) << " (" << ms << " ms)" << std::endl;
+    return 0;
+}
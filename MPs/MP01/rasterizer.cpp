@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <vector>
 #include <cmath>
@@ -7,6 +8,12 @@
 #include "rasterizer.h"
 
 using namespace std;
+
+DepthPass depthPass = PASS_NORMAL;
+
+static thread_local RasterStats localStats;
+static std::atomic<uint64_t> totalFragments(0), totalShaded(0);
+
 Vec2 Vec2::operator+(const Vec2 &v) const {
     return Vec2(x + v.x, y + v.y);
 }
@@ -46,197 +53,297 @@ Vec4 operator*(float scalar, const Vec4& vec) {
 }
 
 
-std::vector<Vertex> DDA(const Vertex &start, const Vertex &end, bool dirY) {
+// Number of varyings the current pipeline reads; only these are interpolated.
+// The depth-only pass is position-only. Reads parser state, so raster workers
+// get the count captured when their triangles were queued instead.
+int activeVaryings() {
+    if (depthPass == PASS_DEPTH_ONLY) return 0;
+    return texcoords.empty() ? VARYING_TEXCOORD : VARYING_COUNT;
+}
+
+// Pack a vertex's attributes into varying slots
+static void loadVaryings(const Vertex &v, float out[MAX_VARYINGS]) {
+    out[VARYING_COLOR + 0] = v.color.x;
+    out[VARYING_COLOR + 1] = v.color.y;
+    out[VARYING_COLOR + 2] = v.color.z;
+    out[VARYING_COLOR + 3] = v.color.w;
+    out[VARYING_TEXCOORD + 0] = v.texcoord.x;
+    out[VARYING_TEXCOORD + 1] = v.texcoord.y;
+}
+
+// Gradient of the plane through (a, va), (b, vb), (c, vc), anchored at a
+static PlaneEq makePlane(const Vertex &a, const Vertex &b, const Vertex &c,
+                         float va, float vb, float vc, float invDet) {
+    float e1x = b.position.x - a.position.x, e1y = b.position.y - a.position.y;
+    float e2x = c.position.x - a.position.x, e2y = c.position.y - a.position.y;
+    float d1 = vb - va, d2 = vc - va;
+    PlaneEq p;
+    p.dx = (d1 * e2y - d2 * e1y) * invDet;
+    p.dy = (d2 * e1x - d1 * e2x) * invDet;
+    p.value = va;
+    return p;
+}
+
+bool setupTriangle(const Vertex &a, const Vertex &b, const Vertex &c, int numVaryings, TriangleSetup &tri) {
     /*
-    Finds all points vector p between vector a and vector b where p_d is an integer
+    Computes one plane equation per interpolated quantity so that any
+    fragment can be evaluated directly, without stepping across the triangle.
 
-    Inputs:
-    - Vertex start
-    - Vertex end
-    Output:
-    - all points between start and end
+    In perspective (hyp) mode the planes are over 1/w, z/w and attr/w;
+    the fragment stage divides the attributes by the interpolated 1/w and
+    uses z/w directly as depth.
+    Returns false for degenerate (zero-area) triangles, which cover no pixels.
     */
-    // set up
-    Vertex a = start;
-    Vertex b = end;    
-    int d = dirY? 1 : 0;
-
-    // 1: If a_d == b_d, return (no points found)
-    if (a.position[d] == b.position[d]) return {};
-    
-    // 2: If a_d > b_d, swap a and b
-    if (a.position[d] > b.position[d]) std::swap(a, b);
-    
-    // 3: Calculate deltas
-    Vertex delta = b - a;
+    float e1x = b.position.x - a.position.x, e1y = b.position.y - a.position.y;
+    float e2x = c.position.x - a.position.x, e2y = c.position.y - a.position.y;
+    float det = e1x * e2y - e2x * e1y;
+    if (det == 0 || !std::isfinite(det)) return false;
+    float invDet = 1.0f / det;
+
+    tri.x0 = a.position.x;
+    tri.y0 = a.position.y;
+    tri.numVaryings = numVaryings;
+    tri.perspective = hypEnabled;
+
+    const Vertex *v[3] = {&a, &b, &c};
+    float q[3] = {1, 1, 1};     // per-vertex weight, 1/w in perspective mode
+    if (tri.perspective)
+    {
+        for (int i = 0; i < 3; ++i) q[i] = 1.0f / v[i]->position.w;
+        tri.invW = makePlane(a, b, c, q[0], q[1], q[2], invDet);
+    }
+    tri.z = makePlane(a, b, c, a.position.z * q[0], b.position.z * q[1], c.position.z * q[2], invDet);
 
-    // 4: step s = delta / delta_d
-    float delta_d = delta.position[d];
-    Vertex s = delta / delta_d;
+    float attr[3][MAX_VARYINGS];
+    for (int i = 0; i < 3; ++i) loadVaryings(*v[i], attr[i]);
+    for (int k = 0; k < tri.numVaryings; ++k)
+    {
+        tri.varyings[k] = makePlane(a, b, c, attr[0][k] * q[0], attr[1][k] * q[1], attr[2][k] * q[2], invDet);
+    }
+    return true;
+}
 
-    // 5: Find the first potential point: e = ceiling(a_d) - a_d
-    float e = std::ceil(a.position[d]) - a.position[d];
 
-    // Step 6: o = e * s
-    Vertex o = s * e;
-    
-    // 7: p = a + o
-    Vertex p = a + o;
+// Integer x in [xa, xb) (either order) as [xStart, xEnd), clipped to the scissor
+static void spanRange(float xa, float xb, int &xStart, int &xEnd) {
+    if (xa > xb) std::swap(xa, xb);
+    xStart = (int)std::max(std::ceil(xa), (float)scissor.x0);
+    xEnd = (int)std::min(std::ceil(xb), (float)scissor.x1);
+}
 
-    // 8: Find all points; While p_d < b_d repeat
-    std::vector<Vertex> intpVertices;
-    while(p.position[d] < b.position[d])
+// Evaluate the planes for every x in [xStart, xEnd) on row y and send the fragments to setPixel
+static void shadeSpan(const TriangleSetup &tri, int xStart, int xEnd, int y) {
+    Fragment f;
+    f.y = y;
+    f.numVaryings = tri.numVaryings;
+    for (int x = xStart; x < xEnd; ++x)
     {
-        intpVertices.push_back(p);
-        setPixel(p);
-        p = p + s;
+        f.x = x;
+        float fx = (float)x, fy = (float)y;
+        float w = tri.perspective ? 1.0f / tri.eval(tri.invW, fx, fy) : 1.0f;
+        f.z = tri.eval(tri.z, fx, fy);      // z/w is linear in screen space
+        for (int k = 0; k < tri.numVaryings; ++k)
+        {
+            f.varyings[k] = tri.eval(tri.varyings[k], fx, fy) * w;
+        }
+        setPixel(f);
     }
+}
+
+void DDA(const TriangleSetup &tri, float xa, float xb, int y) {
+    /*
+    Finds all points p on row y between xa and xb where p_x is an integer
+    and sends them to setPixel
 
-    return intpVertices;  // Return all the interpolated vertices
+    Inputs:
+    - triangle planes
+    - span ends xa and xb on row y
+    */
+    // 1-2: Order the ends; 3: every integer x in [a_x, b_x), clipped to the scissor
+    int xStart, xEnd;
+    spanRange(xa, xb, xStart, xEnd);
+    shadeSpan(tri, xStart, xEnd, y);
 }
 
 
-// Scanline algorithm
-void Scanline(const Vertex& p_input, const Vertex& q_input, const Vertex& r_input) 
+// x where the edge from a to b crosses row y
+static float edgeX(const Vertex &a, const Vertex &b, float y) {
+    return a.position.x + (y - a.position.y) * (b.position.x - a.position.x) / (b.position.y - a.position.y);
+}
+
+// Scanline algorithm, interpolating the first numVaryings varyings
+void Scanline(const Vertex& p, const Vertex& q, const Vertex& r, int numVaryings) 
 {
+#ifndef NDEBUG
     std::cout << "Scanline..." << std::endl;
-    int d_x = 0;
-    int d_y = 1; 
-    // Copy inputs
-    Vertex p = p_input;
-    Vertex q = q_input;
-    Vertex r = r_input;
-
-    // Steps 1-3: Sort the points by y-coordinate
-    std::vector<Vertex> verts = {p, q, r};
-    std::sort(verts.begin(), verts.end(), [](const Vertex &a, const Vertex &b) {
-        if (a.position.y != b.position.y) return a.position.y < b.position.y;
-        else return a.position.x < b.position.x;
-    });
-    const Vertex &top = verts[0];
-    const Vertex &mid = verts[1];
-    const Vertex &bot = verts[2];
-
-    // Step 4: Setup DDA for long edge (top to bot)
-    Vertex p_long, s_long;
+#endif
+
+    // Triangles whose bounding box misses the scissor are rejected before setup
+    float minX = std::min({p.position.x, q.position.x, r.position.x});
+    float maxX = std::max({p.position.x, q.position.x, r.position.x});
+    float minY = std::min({p.position.y, q.position.y, r.position.y});
+    float maxY = std::max({p.position.y, q.position.y, r.position.y});
+    if (maxX < scissor.x0 || minX >= scissor.x1 || maxY < scissor.y0 || minY >= scissor.y1) return;
+
+    if (!std::isfinite(minX + maxX + minY + maxY)) return;     // setup would reject it
+
+    // Steps 1-3: Sort the points by y-coordinate, then x
+    auto above = [](const Vertex *a, const Vertex *b) {
+        if (a->position.y != b->position.y) return a->position.y < b->position.y;
+        else return a->position.x < b->position.x;
+    };
+    const Vertex *verts[3] = {&p, &q, &r};
+    if (above(verts[1], verts[0])) std::swap(verts[0], verts[1]);
+    if (above(verts[2], verts[1])) std::swap(verts[1], verts[2]);
+    if (above(verts[1], verts[0])) std::swap(verts[0], verts[1]);
+    const Vertex &top = *verts[0];
+    const Vertex &mid = *verts[1];
+    const Vertex &bot = *verts[2];
+
+    // Step 4: Walk rows where y is an integer; the long edge spans top to bot,
+    // the short edge is top to mid for the top half and mid to bot below it.
+    // Edge x is computed directly per row, so there is no accumulated drift.
+    // Rows outside the scissor are skipped.
+    int yStart = (int)std::max(std::ceil(top.position.y), (float)scissor.y0);
+    int yEnd = (int)std::min(std::ceil(bot.position.y), (float)scissor.y1);
+    if (yStart >= yEnd) return;     // no sample rows
+    auto rowSpan = [&](int y, int &xStart, int &xEnd) {
+        float xLong = edgeX(top, bot, (float)y);
+        float xEdge = (y < mid.position.y) ? edgeX(top, mid, (float)y) : edgeX(mid, bot, (float)y);
+        spanRange(xEdge, xLong, xStart, xEnd);
+    };
+
+    // Small triangles: find the covered samples before paying for setup; most
+    // triangles of a dense mesh cover none
+    if (yEnd - yStart <= SMALL_TRIANGLE_ROWS)
     {
-        Vertex a = top;
-        Vertex b = bot;
-        //if (a.position[d_y] == b.position[d_y]) return;
-        if (a.position[d_y] > b.position[d_y]) std::swap(a, b);
-        Vertex delta = b - a;
-        float delta_d = delta.position[d_y];
-        Vertex s = delta / delta_d;
-        float e = std::ceil(a.position[d_y]) - a.position[d_y];
-        Vertex o = s * e;
-        p_long = a + o;
-        s_long = s;
-    }
-    
-    // Find points in the top half of the triangle:
-    // Step 5: Setup DDA for top half edge from t to m
-    Vertex p_edge, s_edge;
-    {
-        Vertex a = top;
-        Vertex b = mid;
-        //if (a.position[d_y] == b.position[d_y]) return;
-        if (a.position[d_y] > b.position[d_y]) std::swap(a, b);
-        Vertex delta = b - a;
-        float delta_d = delta.position[d_y];
-        Vertex s = delta / delta_d;
-        float e = std::ceil(a.position[d_y]) - a.position[d_y];
-        Vertex o = s * e;
-        p_edge = a + o;
-        s_edge = s;
-    }
+        int spanStart[SMALL_TRIANGLE_ROWS], spanEnd[SMALL_TRIANGLE_ROWS];
+        bool covered = false;
+        for (int y = yStart; y < yEnd; ++y)
+        {
+            rowSpan(y, spanStart[y - yStart], spanEnd[y - yStart]);
+            covered |= spanStart[y - yStart] < spanEnd[y - yStart];
+        }
+        if (!covered) return;
 
-    // Step 6: DDA loop for top half of the triangle
-    while(p_edge.position[d_y] < mid.position[d_y])    
-    {
-        // Run DDA in x between p_edge and p_long
-        std::vector<Vertex> scanline = DDA(p_edge, p_long, false);
-        p_edge = p_edge + s_edge;
-        p_long = p_long + s_long;
-        
+        TriangleSetup tri;
+        if (!setupTriangle(p, q, r, numVaryings, tri)) return;
+        for (int y = yStart; y < yEnd; ++y)
+        {
+            shadeSpan(tri, spanStart[y - yStart], spanEnd[y - yStart], y);
+        }
+        return;
     }
 
-    //Find points in the bottom half of the triangle:
-    // Step 7: Setup DDA for bottom half edge from m to b
+    // Triangle setup: plane equations for depth and varyings
+    TriangleSetup tri;
+    if (!setupTriangle(p, q, r, numVaryings, tri)) return;
+    for (int y = yStart; y < yEnd; ++y)
     {
-        Vertex a = mid;
-        Vertex b = bot;
-        //if (a.position[d_y] == b.position[d_y]) return;
-        if (a.position[d_y] > b.position[d_y]) std::swap(a, b);
-        Vertex delta = b - a;
-        float delta_d = delta.position[d_y];
-        Vertex s = delta / delta_d;
-        float e = std::ceil(a.position[d_y]) - a.position[d_y];
-        Vertex o = s * e;
-        p_edge = a + o;
-        s_edge = s;
+        int xStart, xEnd;
+        rowSpan(y, xStart, xEnd);
+        shadeSpan(tri, xStart, xEnd, y);
     }
+}
 
-    // Step 8: DDA loop for bottom half of the triangle
-    while(p_edge.position.y < bot.position.y)
-    {
-        // Run DDA in x between p_edge and p_long
-        std::vector<Vertex> scanline = DDA(p_edge, p_long, false);
-        p_edge = p_edge + s_edge;
-        p_long = p_long + s_long;
-        // std::cout << "Bot half working..." << std::endl;    // Debugging
-    }
+void Scanline(const Vertex& p, const Vertex& q, const Vertex& r)
+{
+    Scanline(p, q, r, activeVaryings());
 }
 
 
+// Texture channel as a linear color; texture files are sRGB encoded
+static float textureChannel(uint8_t value)
+{
+    static const std::vector<float> linear = [] {
+        std::vector<float> table(256);
+        for (int i = 0; i < 256; ++i)
+        {
+            float c = i / 255.0f;
+            table[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+    return sRGBEnabled ? linear[value] : value / 255.0f;
+}
+
 // Set a pixel in the img 
-void setPixel(Vertex p) {
-    int x = static_cast<int>(p.position.x);
-    int y = static_cast<int>(p.position.y);
-    float depth = p.position.z;
+void setPixel(const Fragment &f) {
+    int x = f.x;
+    int y = f.y - imgOriginY;
+    float depth = f.z;
     if (x < 0 || x >= (int)img->width() || y < 0 || y >= (int)img->height()) {
         return;  // Out of bounds
     }
-    //// alpha blending
-    // float srcAlpha = color.w;
-    // float invAlpha = 1.0f - srcAlpha;
-
-    std::cout << "Setting pixel: (" << p.position.x << ", " << p.position.y << ") & color: ("
-              << p.color.x << ", " << p.color.y << ", " << p.color.z << ", " << p.color.w << ")\n";    // Debugging
+    ++localStats.fragments;
 
-    // Update the depth buffer
-    if (sRGBEnabled) // gamma correction 
+    // Depth test before shading, so occluded fragments are never shaded
+    if (depthPass == PASS_DEPTH_ONLY)
+    {
+        depthBuffer.testAndSet(x, y, depth);
+        return;
+    }
+    if (depthPass == PASS_SHADE_EQUAL)
     {
-        p.color.x = converToSRGB(p.color.x);
-        p.color.y = converToSRGB(p.color.y);
-        p.color.z = converToSRGB(p.color.z);
+        if (!depthBuffer.testEqual(x, y, depth)) return;
     }
-    if (hypEnabled) 
+    else if (depthEnabled && !depthBuffer.testAndSet(x, y, depth))
     {
-        p.color = p.color / (1 / p.position.w);
+        return;
     }
+    ++localStats.shaded;
 
-    // Perform depth testing if enabled
-    if (depthEnabled) 
+    Vec4 color(f.varyings[VARYING_COLOR + 0], f.varyings[VARYING_COLOR + 1],
+               f.varyings[VARYING_COLOR + 2], f.varyings[VARYING_COLOR + 3]);
+    const Texture *texture = boundTexture.get();
+    if (texture && f.numVaryings == VARYING_COUNT)
     {
-        if (depth < depthBuffer[y][x]) 
+        const pixel_t &texel = texture->sample(f.varyings[VARYING_TEXCOORD + 0], f.varyings[VARYING_TEXCOORD + 1]);
+        Vec4 t(textureChannel(texel.r), textureChannel(texel.g), textureChannel(texel.b), texel.a / 255.0f);
+        if (decalsEnabled)  // texture over the vertex color
         {
-            depthBuffer[y][x] = depth;
-            pixel_t &pixel = img->operator[](y)[x];
-            pixel.r = static_cast<uint8_t>(p.color.x * 255.0f);
-            pixel.g = static_cast<uint8_t>(p.color.y * 255.0f);
-            pixel.b = static_cast<uint8_t>(p.color.z * 255.0f);
-            pixel.a = static_cast<uint8_t>(p.color.w * 255.0f);
+            color = Vec4(t.x * t.w + color.x * (1 - t.w), t.y * t.w + color.y * (1 - t.w),
+                         t.z * t.w + color.z * (1 - t.w), t.w + color.w * (1 - t.w));
         }
-    } 
-    else 
+        else color = t;
+    }
+    //// alpha blending
+    // float srcAlpha = color.w;
+    // float invAlpha = 1.0f - srcAlpha;
+
+#ifndef NDEBUG
+    std::cout << "Setting pixel: (" << x << ", " << y << ") & color: ("
+              << color.x << ", " << color.y << ", " << color.z << ", " << color.w << ")\n";    // Debugging
+#endif
+
+    if (sRGBEnabled) // gamma correction 
     {
-        // Draw pixel without depth testing
-        pixel_t &pixel = img->operator[](y)[x];
-        pixel.r = static_cast<uint8_t>(p.color.x * 255.0f);
-        pixel.g = static_cast<uint8_t>(p.color.y * 255.0f);
-        pixel.b = static_cast<uint8_t>(p.color.z * 255.0f);
-        pixel.a = static_cast<uint8_t>(p.color.w * 255.0f);
+        color.x = converToSRGB(color.x);
+        color.y = converToSRGB(color.y);
+        color.z = converToSRGB(color.z);
     }
+
+    pixel_t &pixel = img->at(x, y);
+    pixel.r = static_cast<uint8_t>(color.x * 255.0f);
+    pixel.g = static_cast<uint8_t>(color.y * 255.0f);
+    pixel.b = static_cast<uint8_t>(color.z * 255.0f);
+    pixel.a = static_cast<uint8_t>(color.w * 255.0f);
+}
+
+
+void flushRasterStats()
+{
+    totalFragments += localStats.fragments;
+    totalShaded += localStats.shaded;
+    localStats = RasterStats();
+}
+
+RasterStats totalRasterStats()
+{
+    RasterStats s;
+    s.fragments = totalFragments;
+    s.shaded = totalShaded;
+    return s;
 }
 
 float converToSRGB(float value) {
@@ -255,16 +362,9 @@ void drawArraysTriangles(int first, int count)
         Vertex v0 = vertices[first + i];
         Vertex v1 = vertices[first + i + 1];
         Vertex v2 = vertices[first + i + 2];
+#ifndef NDEBUG
         std::cout << "Draw arrays triangles starting with " << first + i << " " << first + i + 1 << " " << first + i + 2 << std::endl;
-        if (hypEnabled) 
-        {
-            v0.position = v0.position / v0.position.w;
-            v1.position = v1.position / v1.position.w;
-            v2.position = v2.position / v2.position.w;
-            v0.color = v0.color / v0.position.w;
-            v1.color = v1.color / v1.position.w;
-            v2.color = v2.color / v2.position.w;
-        }
+#endif
         // Draw the triangle using scanline
         Scanline(v0, v1, v2);
     }
@@ -289,21 +389,37 @@ void drawElementsTriangles(int count, int offset)
         Vertex v1 = vertices[idx1];
         Vertex v2 = vertices[idx2];
 
-        // Perspective-correct interpolation if 'hyp' (hyperbolic interpolation) is enabled
-        if (hypEnabled) {
-            v0.position = v0.position / v0.position.w;
-            v1.position = v1.position / v1.position.w;
-            v2.position = v2.position / v2.position.w;
-            v0.color = v0.color / v0.position.w;
-            v1.color = v1.color / v1.position.w;
-            v2.color = v2.color / v2.position.w;
-        }
+        Scanline(v0, v1, v2);
+    }
+}
 
-        if (v1.position.y < v0.position.y) { std::swap(v0, v1); }
-        if (v2.position.y < v0.position.y) { std::swap(v0, v2); }
-        if (v2.position.y < v1.position.y) { std::swap(v1, v2); }
 
-        Scanline(v0, v1, v2);
+// Copy the triangles of a drawArraysTriangles call out of the vertex buffer
+std::vector<Vertex> arraysTriangles(int first, int count)
+{
+    std::vector<Vertex> tris;
+    for (int i = 0; i + 2 < count; i += 3)
+    {
+        tris.push_back(vertices[first + i]);
+        tris.push_back(vertices[first + i + 1]);
+        tris.push_back(vertices[first + i + 2]);
     }
+    return tris;
 }
 
+// Copy the triangles of a drawElementsTriangles call out of the vertex buffer
+std::vector<Vertex> elementsTriangles(int count, int offset)
+{
+    std::vector<Vertex> tris;
+    if (offset < 0 || offset + count > (int)elements.size()) {
+        std::cerr << "Error: offset and count out of bounds." << std::endl;
+        return tris;
+    }
+    for (int i = 0; i + 2 < count; i += 3)
+    {
+        tris.push_back(vertices[elements[offset + i]]);
+        tris.push_back(vertices[elements[offset + i + 1]]);
+        tris.push_back(vertices[elements[offset + i + 2]]);
+    }
+    return tris;
+}
@@ -2,7 +2,10 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
-#include "uselibpng.h"
+#include <stdexcept>
+#include "rendertarget.h"
+#include "depthbuffer.h"
+#include "texture.h"
 
 
 // Data structures 
@@ -83,51 +86,155 @@ struct Vertex {
         Vertex result;
         result.position = this->position - other.position;
         result.color = this->color - other.color;
+        result.texcoord = this->texcoord - other.texcoord;
         return result;
     }
 
-    // Add two vertices (add their positions and colors)
+    // Add two vertices (add their positions, colors and texcoords)
     Vertex operator+(const Vertex& other) const {
         Vertex result;
         result.position = this->position + other.position;
         result.color = this->color + other.color;
+        result.texcoord = this->texcoord + other.texcoord;
         return result;
     }
 
-    // Scalar multiplication for interpolation (position and color)
+    // Scalar multiplication for interpolation (position, color and texcoord)
     Vertex operator*(float scalar) const {
         Vertex result;
         result.position = this->position * scalar;
         result.color = this->color * scalar;
+        result.texcoord = this->texcoord * scalar;
         return result;
     }
 
-    // Scalar multiplication for interpolation (position and color)
+    // Scalar division for interpolation (position, color and texcoord)
     Vertex operator/(float scalar) const {
         Vertex result;
         result.position = this->position / scalar;
         result.color = this->color / scalar;
+        result.texcoord = this->texcoord / scalar;
         return result;
     }
 
 };
 
 
+// Varyings
+// Upper bound on the scalar attributes interpolated per fragment
+constexpr int MAX_VARYINGS = 8;
+
+// Where each vertex attribute lives in the varying array
+enum VaryingSlot {
+    VARYING_COLOR    = 0,   // r, g, b, a
+    VARYING_TEXCOORD = 4,   // s, t
+    VARYING_COUNT    = 6
+};
+static_assert(VARYING_COUNT <= MAX_VARYINGS, "too many varyings");
+
+// attr(x, y) = value + dx * (x - x0) + dy * (y - y0)
+struct PlaneEq {
+    float dx, dy, value;
+};
+
+// Per-triangle interpolation state, computed once in triangle setup
+struct TriangleSetup {
+    float x0, y0;                       // reference point of every plane
+    PlaneEq z;
+    PlaneEq invW;                       // 1/w, only used when perspective
+    PlaneEq varyings[MAX_VARYINGS];     // attr or attr/w
+    int numVaryings;
+    bool perspective;
+
+    float eval(const PlaneEq &p, float x, float y) const {
+        return p.value + p.dx * (x - x0) + p.dy * (y - y0);
+    }
+};
+
+// A sample produced by the rasterizer and consumed by setPixel
+struct Fragment {
+    int x, y;
+    float z;
+    float varyings[MAX_VARYINGS];
+    int numVaryings;                    // valid entries of varyings, from the triangle's setup
+};
+
+
+// Screen rectangle [x0, x1) x [y0, y1)
+struct Rect {
+    int x0, y0, x1, y1;
+
+    bool empty() const { return x0 >= x1 || y0 >= y1; }
+};
+
+
 extern std::vector<Vertex> vertices;
 extern std::vector<Vec4> positions;
 extern std::vector<Vec4> colors;
-extern Image* img;
+extern RenderTarget* img;
 extern std::vector<int> elements;
-extern std::vector<std::vector<float>> depthBuffer; // std::vector<float> depthBuffer;
+extern DepthBuffer depthBuffer;
 extern std::vector<Vec2> texcoords;
 extern bool hypEnabled;
 extern bool sRGBEnabled;
 extern bool depthEnabled;
+// Which part of a depth pre-pass is running
+enum DepthPass {
+    PASS_NORMAL,        // depth test (if enabled) and shade
+    PASS_DEPTH_ONLY,    // position-only, writes depth, no color
+    PASS_SHADE_EQUAL    // shades only fragments whose depth equals the stored one
+};
+
+// Fragment counters; shaded <= fragments, the gap is what early depth saved
+struct RasterStats {
+    uint64_t fragments = 0;
+    uint64_t shaded = 0;
+};
 
-std::vector<Vertex> DDA(const Vertex &a, const Vertex &b, bool dirY);
-void scanlineFill(const Vertex &p1, const Vertex &p2, const Vertex &p3);
+extern DepthPass depthPass;
+extern thread_local Rect scissor;    // fragments outside are never generated
+extern std::shared_ptr<const Texture> boundTexture;     // sampled with the texcoord varyings
+extern bool decalsEnabled;          // blend the texture over the color instead of replacing it
+extern int imgOriginY;              // image row stored in img's row 0 (bands, worker regions)
 
-void setPixel(Vertex p);
+// Triangles spanning at most this many sample rows take the small-triangle path
+constexpr int SMALL_TRIANGLE_ROWS = 4;
+
+int activeVaryings();
+bool setupTriangle(const Vertex &a, const Vertex &b, const Vertex &c, int numVaryings, TriangleSetup &tri);
+void DDA(const TriangleSetup &tri, float xa, float xb, int y);
+void Scanline(const Vertex &p, const Vertex &q, const Vertex &r, int numVaryings);
+void Scanline(const Vertex &p, const Vertex &q, const Vertex &r);
+
+void setPixel(const Fragment &f);
 float converToSRGB(float value);
+void flushRasterStats();
+RasterStats totalRasterStats();
 void drawArraysTriangles(int first, int count);
 void drawElementsTriangles(int count, int offset);
+std::vector<Vertex> arraysTriangles(int first, int count);
+std::vector<Vertex> elementsTriangles(int count, int offset);
+
+
+// A draw captured to be rasterized later (pre-pass, banded and sequence modes)
+struct RecordedDraw {
+    std::vector<Vertex> triangles;              // 3 vertices per triangle
+    std::shared_ptr<const Texture> texture;     // bound when the draw was recorded
+
+    size_t triangleCount() const { return triangles.size() / 3; }
+    void draw(size_t t) const { Scanline(triangles[3 * t], triangles[3 * t + 1], triangles[3 * t + 2]); }
+};
+
+// Replay draws in order, each under the texture it was recorded with;
+// replay(index, draw) rasterizes the triangles of the draw that are needed
+template <class Draw, class F>
+void replayDraws(const std::vector<Draw> &draws, F replay)
+{
+    std::shared_ptr<const Texture> current = boundTexture;
+    for (size_t i = 0; i < draws.size(); ++i)
+    {
+        boundTexture = draws[i].texture;
+        replay(i, draws[i]);
+    }
+    boundTexture = current;
+}
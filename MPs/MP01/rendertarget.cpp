@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <mutex>
+#include "rendertarget.h"
+
+RenderTarget::RenderTarget(uint32_t width, uint32_t height, RenderLayout layout)
+    : w(width), h(height), mode(layout), texels(layoutSize(layout, width, height), pixel_t{}) {}
+
+void RenderTarget::readRow(uint32_t y, pixel_t *row) const
+{
+    if (mode == LAYOUT_LINEAR)
+    {
+        std::copy(&texels[(size_t)y * w], &texels[(size_t)y * w] + w, row);
+        return;
+    }
+    // whole 8-pixel block rows are contiguous in the tiled layout
+    for (uint32_t x = 0; x < w; x += LAYOUT_BLOCK)
+    {
+        const pixel_t *src = &texels[layoutIndex(mode, w, x, y)];
+        for (uint32_t i = 0; i < LAYOUT_BLOCK && x + i < w; ++i) row[x + i] = src[i];
+    }
+}
+
+static void rowSource(void *ctx, uint32_t y, pixel_t *row)
+{
+    static_cast<const RenderTarget *>(ctx)->readRow(y, row);
+}
+
+void RenderTarget::save(const char *filename) const
+{
+    save_image_rows(w, h, rowSource, const_cast<RenderTarget *>(this), filename);
+}
+
+
+static std::mutex poolMutex;
+static std::vector<RenderTarget *> pool;    // most recently released last
+
+RenderTarget *acquireRenderTarget(uint32_t width, uint32_t height, RenderLayout layout)
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        for (size_t i = pool.size(); i-- > 0;)
+        {
+            RenderTarget *target = pool[i];
+            if (target->width() != width || target->height() != height || target->layout() != layout) continue;
+            pool.erase(pool.begin() + i);
+            target->clear();
+            return target;
+        }
+    }
+    return new RenderTarget(width, height, layout);
+}
+
+void releaseRenderTarget(RenderTarget *target)
+{
+    if (!target) return;
+    std::lock_guard<std::mutex> lock(poolMutex);
+    pool.push_back(target);
+    if (pool.size() > RENDER_TARGET_POOL)
+    {
+        delete pool.front();
+        pool.erase(pool.begin());
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include "uselibpng.h"
+#include "layout.h"
+
+/*
+Color render target in a selectable memory layout. Pixels are only
+converted to linear rows when saving, one row at a time, straight into
+the PNG encoder.
+*/
+class RenderTarget {
+  public:
+    RenderTarget(uint32_t width, uint32_t height, RenderLayout layout = LAYOUT_TILED);
+
+    /// pixel access; note the x-first order, unlike Image
+    pixel_t &at(uint32_t x, uint32_t y) { return texels[layoutIndex(mode, w, x, y)]; }
+    const pixel_t &at(uint32_t x, uint32_t y) const { return texels[layoutIndex(mode, w, x, y)]; }
+
+    /// set every pixel to transparent black
+    void clear() { std::fill(texels.begin(), texels.end(), pixel_t{}); }
+
+    /// copy row y into row[0 .. width)
+    void readRow(uint32_t y, pixel_t *row) const;
+
+    /// store the image in a PNG file
+    void save(const char *filename) const;
+
+    uint32_t width() const { return w; }
+    uint32_t height() const { return h; }
+    RenderLayout layout() const { return mode; }
+
+  private:
+    uint32_t w, h;
+    RenderLayout mode;
+    std::vector<pixel_t> texels;
+};
+
+// Targets kept for reuse by releaseRenderTarget()
+constexpr size_t RENDER_TARGET_POOL = 4;
+
+// A cleared target, recycled from the pool when one of the same size and layout
+// is there, so a long-running process does not reallocate its framebuffers
+RenderTarget *acquireRenderTarget(uint32_t width, uint32_t height, RenderLayout layout);
+void releaseRenderTarget(RenderTarget *target);
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include "sequence.h"
+
+using namespace std;
+
+bool sequenceEnabled = false;
+
+static std::vector<DrawCall> draws;
+static int frameCount = 0;
+static std::string lastFrame;
+
+
+// Record a draw; index -1 appends, otherwise the draw at index is replaced
+void recordDraw(int index, const std::vector<Vertex> &triangles)
+{
+    if (index < 0 || index >= (int)draws.size())
+    {
+        if (index >= 0) std::cerr << "Error: no draw " << index << " to update, appending." << std::endl;
+        index = (int)draws.size();
+        draws.emplace_back();
+    }
+    draws[index].triangles = triangles;
+    draws[index].texture = boundTexture;
+    draws[index].changed = true;
+}
+
+// Drop every recorded draw and leave sequence mode
+void resetSequence()
+{
+    sequenceEnabled = false;
+    draws.clear();
+    frameCount = 0;
+    lastFrame.clear();
+}
+
+std::string lastFrameFile()
+{
+    return lastFrame;
+}
+
+const std::vector<DrawCall> &recordedDraws()
+{
+    return draws;
+}
+
+// True if a draw changed since the last frame
+bool sequencePending()
+{
+    for (const DrawCall &d : draws) if (d.changed) return true;
+    return false;
+}
+
+
+// Pixel bounds of a set of vertices, clipped to the image
+static Rect bounds(const Vertex *v, size_t n)
+{
+    float lo[2] = { std::numeric_limits<float>::infinity(),  std::numeric_limits<float>::infinity()};
+    float hi[2] = {-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (int d = 0; d < 2; ++d)
+        {
+            float p = v[i].position[d];
+            if (std::isnan(p)) continue;
+            lo[d] = std::min(lo[d], p);
+            hi[d] = std::max(hi[d], p);
+        }
+    }
+    // samples are at integer coordinates in [ceil(lo), hi)
+    Rect r;
+    r.x0 = (int)std::max(std::ceil(lo[0]), 0.0f);
+    r.y0 = (int)std::max(std::ceil(lo[1]), 0.0f);
+    r.x1 = (int)std::min(std::ceil(hi[0]), (float)img->width());
+    r.y1 = (int)std::min(std::ceil(hi[1]), (float)img->height());
+    if (r.empty()) r = {0, 0, 0, 0};
+    return r;
+}
+
+
+// Re-bin a draw's triangles into the tiles their bounds touch
+static void binDraw(DrawCall &d, int tilesX)
+{
+    d.tiles.clear();
+    for (size_t i = 0; i + 2 < d.triangles.size(); i += 3)
+    {
+        Rect tb = bounds(&d.triangles[i], 3);
+        if (tb.empty()) continue;
+        for (int ty = tb.y0 / TILE_SIZE; ty <= (tb.y1 - 1) / TILE_SIZE; ++ty)
+            for (int tx = tb.x0 / TILE_SIZE; tx <= (tb.x1 - 1) / TILE_SIZE; ++tx)
+                d.tiles.push_back({ty * tilesX + tx, (uint32_t)(i / 3)});
+    }
+    std::sort(d.tiles.begin(), d.tiles.end());
+}
+
+// Rasterize one triangle into the dirty tiles under its bounds, one scissor per
+// horizontal run of dirty tiles
+static void drawDirty(const Vertex *tri, const std::vector<char> &dirty, int tilesX, int width, int height)
+{
+    Rect tb = bounds(tri, 3);
+    for (int ty = tb.y0 / TILE_SIZE; ty <= (tb.y1 - 1) / TILE_SIZE; ++ty)
+    {
+        int tx = tb.x0 / TILE_SIZE, txEnd = (tb.x1 - 1) / TILE_SIZE + 1;
+        while (tx < txEnd)
+        {
+            if (!dirty[ty * tilesX + tx]) { ++tx; continue; }
+            int runStart = tx;
+            while (tx < txEnd && dirty[ty * tilesX + tx]) ++tx;
+            scissor = {runStart * TILE_SIZE, ty * TILE_SIZE,
+                       std::min(tx * TILE_SIZE, width), std::min((ty + 1) * TILE_SIZE, height)};
+            Scanline(tri[0], tri[1], tri[2]);
+        }
+    }
+}
+
+
+int renderDirtyTiles()
+{
+    /*
+    1: Mark tiles under the old and new bounds of every changed draw dirty,
+       and re-bin its triangles into tiles
+    2: Clear color and depth of dirty tiles
+    3: Re-rasterize the triangles binned to dirty tiles, in draw order,
+       scissored to the dirty tiles
+    */
+    int width = (int)img->width();
+    int height = (int)img->height();
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    std::vector<char> dirty(tilesX * tilesY, frameCount == 0);
+
+    auto markDirty = [&](const Rect &r) {
+        if (r.empty()) return;
+        for (int ty = r.y0 / TILE_SIZE; ty <= (r.y1 - 1) / TILE_SIZE; ++ty)
+            for (int tx = r.x0 / TILE_SIZE; tx <= (r.x1 - 1) / TILE_SIZE; ++tx)
+                dirty[ty * tilesX + tx] = 1;
+    };
+
+    // Step 1
+    for (DrawCall &d : draws)
+    {
+        if (!d.changed) continue;
+        markDirty(d.bounds);
+        d.bounds = bounds(d.triangles.data(), d.triangles.size());
+        markDirty(d.bounds);
+        binDraw(d, tilesX);
+        d.changed = false;
+    }
+
+    // Step 2
+    std::vector<int> dirtyTiles;
+    for (int ty = 0; ty < tilesY; ++ty)
+    {
+        for (int tx = 0; tx < tilesX; ++tx)
+        {
+            if (!dirty[ty * tilesX + tx]) continue;
+            dirtyTiles.push_back(ty * tilesX + tx);
+            int x1 = std::min((tx + 1) * TILE_SIZE, width);
+            int y1 = std::min((ty + 1) * TILE_SIZE, height);
+            for (int y = ty * TILE_SIZE; y < y1; ++y)
+            {
+                for (int x = tx * TILE_SIZE; x < x1; ++x)
+                {
+                    img->at(x, y) = pixel_t{};
+                }
+            }
+            if (depthEnabled) depthBuffer.clearRect(tx * TILE_SIZE, ty * TILE_SIZE, x1, y1);
+        }
+    }
+
+    // Step 3
+    if (!dirtyTiles.empty())
+    {
+        std::vector<uint32_t> visible;
+        replayDraws(draws, [&](size_t, const DrawCall &d) {
+            visible.clear();
+            for (int tile : dirtyTiles)
+            {
+                auto first = std::lower_bound(d.tiles.begin(), d.tiles.end(), std::make_pair(tile, 0u));
+                for (auto it = first; it != d.tiles.end() && it->first == tile; ++it) visible.push_back(it->second);
+            }
+            std::sort(visible.begin(), visible.end());
+            visible.erase(std::unique(visible.begin(), visible.end()), visible.end());
+            for (uint32_t t : visible) drawDirty(&d.triangles[3 * t], dirty, tilesX, width, height);
+        });
+        scissor = {0, 0, width, height};
+    }
+    ++frameCount;
+    return (int)dirtyTiles.size();
+}
+
+void renderFrame(const std::string &filename)
+{
+    int dirtyTiles = renderDirtyTiles();
+    int tiles = (int)(((img->width() + TILE_SIZE - 1) / TILE_SIZE) * ((img->height() + TILE_SIZE - 1) / TILE_SIZE));
+    std::cout << "Frame " << frameCount - 1 << ": " << dirtyTiles << "/" << tiles
+              << " tiles re-rendered, saving to " << filename << std::endl;
+    img->save(filename.c_str());
+    lastFrame = filename;
+}
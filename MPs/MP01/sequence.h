@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "rasterizer.h"
+
+/*
+Sequence mode: incremental re-render of animated frames.
+
+Draw calls are recorded instead of rasterized. Each `frame` renders only the
+tiles touched by draws that changed since the previous frame (at their old
+and new screen bounds); every other tile keeps its color and depth.
+
+    sequence
+    position ...
+    drawArraysTriangles 0 3          # draw 0
+    frame anim-000.png
+    position ...                     # changed buffer
+    update 0 drawArraysTriangles 0 3 # re-capture draw 0 from the current buffers
+    frame anim-001.png
+*/
+
+// Side length of a dirty-tracking tile in pixels
+constexpr int TILE_SIZE = 32;
+
+struct DrawCall : RecordedDraw {
+    Rect bounds = {0, 0, 0, 0};     // screen bounds when last rendered
+    bool changed = true;            // needs re-rasterizing in the next frame
+    std::vector<std::pair<int, uint32_t>> tiles;   // (tile, triangle) pairs under each triangle's bounds, sorted
+};
+
+extern bool sequenceEnabled;
+
+void recordDraw(int index, const std::vector<Vertex> &triangles);
+void resetSequence();
+bool sequencePending();
+// Every recorded draw, in draw order
+const std::vector<DrawCall> &recordedDraws();
+// Steps 1-3 of renderFrame without saving; returns the number of tiles re-rendered
+int renderDirtyTiles();
+// File written by the latest frame, empty before the first
+std::string lastFrameFile();
+void renderFrame(const std::string &filename);
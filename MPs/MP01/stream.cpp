@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "stream.h"
+
+using namespace std;
+
+struct Batch {
+    std::vector<Vertex> triangles;  // 3 vertices per triangle
+    int numVaryings;                // activeVaryings() when queued; workers never read parser state
+};
+
+// One queue shared by all workers; an entry is dropped once every worker has
+// consumed it. Entry i of the queue has sequence number head + i.
+static std::mutex queueMutex;
+static std::condition_variable queueChanged;
+static std::deque<std::shared_ptr<const Batch>> queue;
+static size_t head = 0;
+static std::vector<size_t> nextBatch;    // per-worker sequence number to consume
+static std::vector<std::thread> workers;
+static bool finished = false;
+
+
+// Drop batches every worker is done with; caller holds queueMutex
+static void popConsumed()
+{
+    size_t oldest = *std::min_element(nextBatch.begin(), nextBatch.end());
+    while (head < oldest)
+    {
+        queue.pop_front();
+        ++head;
+    }
+}
+
+static void worker(int id, Rect band)
+{
+    scissor = band;
+    while (true)
+    {
+        std::shared_ptr<const Batch> batch;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [&] { return nextBatch[id] < head + queue.size() || finished; });
+            if (nextBatch[id] == head + queue.size())   // finished and drained
+            {
+                DepthBuffer::flushStats();
+                flushRasterStats();
+                return;
+            }
+            batch = queue[nextBatch[id] - head];
+        }
+
+        const std::vector<Vertex> &tris = batch->triangles;
+        for (size_t i = 0; i + 2 < tris.size(); i += 3)
+        {
+            Scanline(tris[i], tris[i + 1], tris[i + 2], batch->numVaryings);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            ++nextBatch[id];
+            popConsumed();
+        }
+        queueChanged.notify_all();
+    }
+}
+
+
+void startStream(int count)
+{
+    // Bands are whole rows of depth tiles, so no two workers touch one tile;
+    // img row 0 is image row imgOriginY
+    int height = (int)img->height();
+    int tileRows = (height + DEPTH_TILE - 1) / DEPTH_TILE;
+    count = std::max(1, std::min(count, tileRows));
+    finished = false;
+    head = 0;
+    nextBatch.assign(count, 0);
+    for (int i = 0; i < count; ++i)
+    {
+        Rect band = {0, imgOriginY + std::min(tileRows * i / count * DEPTH_TILE, height), (int)img->width(),
+                     imgOriginY + std::min(tileRows * (i + 1) / count * DEPTH_TILE, height)};
+        band = {std::max(band.x0, scissor.x0), std::max(band.y0, scissor.y0),
+                std::min(band.x1, scissor.x1), std::min(band.y1, scissor.y1)};
+        workers.emplace_back(worker, i, band);
+    }
+    std::cout << "Streaming with " << count << " raster workers." << std::endl;
+}
+
+bool streamActive()
+{
+    return !workers.empty();
+}
+
+// Vertex i of the position/color/texcoord buffers, assembled as initVertices does
+static Vertex bufferVertex(int i)
+{
+    if (i < 0 || i >= (int)positions.size()) return Vertex();
+    Vec4 col = (i < (int)colors.size()) ? colors[i] : Vec4();
+    Vec2 tex = (i < (int)texcoords.size()) ? texcoords[i] : Vec2();
+    return Vertex(positions[i], col, tex);
+}
+
+// Queue the triangles of vertices index(0) .. index(count - 1), cutting each
+// batch from the buffers only once the queue has room for it, so at most
+// STREAM_QUEUE_SIZE batches of a draw are ever materialized
+template <typename Index>
+static void streamRange(int count, Index index)
+{
+    int step = STREAM_BATCH_TRIANGLES * 3;
+    int numVaryings = activeVaryings();
+    int end = count - count % 3;
+    for (int i = 0; i < end; i += step)
+    {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [] { return queue.size() < STREAM_QUEUE_SIZE; });
+        }
+        // Only the parser thread pushes, so the room it waited for stays free
+        auto batch = std::make_shared<Batch>();
+        batch->triangles.reserve(std::min(step, end - i));
+        for (int v = i; v < std::min(i + step, end); v++)
+            batch->triangles.push_back(bufferVertex(index(v)));
+        batch->numVaryings = numVaryings;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(std::move(batch));
+        }
+        queueChanged.notify_all();
+    }
+}
+
+// Queue a drawArraysTriangles call
+void streamArrays(int first, int count)
+{
+    streamRange(count, [first](int v) { return first + v; });
+}
+
+// Queue a drawElementsTriangles call
+void streamElements(int count, int offset)
+{
+    if (offset < 0 || offset + count > (int)elements.size()) {
+        std::cerr << "Error: offset and count out of bounds." << std::endl;
+        return;
+    }
+    streamRange(count, [offset](int v) { return elements[offset + v]; });
+}
+
+// Wait until every queued batch is rasterized, e.g. before a mode change
+void drainStream()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    queueChanged.wait(lock, [] { return queue.empty(); });
+}
+
+void stopStream()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        finished = true;
+    }
+    queueChanged.notify_all();
+    for (std::thread &t : workers) t.join();
+    workers.clear();
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+#include "rasterizer.h"
+
+/*
+Streaming mode: rasterize while parsing.
+
+The parser thread cuts each draw into batches of triangles and pushes them
+into a bounded queue; raster workers consume the queue concurrently. Every
+worker owns a horizontal band of the image and sees every batch in order,
+so draw order (and the depth test) behaves exactly as in a serial render.
+Batches are cut from the vertex buffers as they are queued, so memory is
+bounded by STREAM_QUEUE_SIZE batches, not by the scene size.
+*/
+
+// Batches held in the queue before the parser blocks
+constexpr size_t STREAM_QUEUE_SIZE = 64;
+// Triangles per batch
+constexpr size_t STREAM_BATCH_TRIANGLES = 256;
+
+void startStream(int workers);
+bool streamActive();
+void streamArrays(int first, int count);
+void streamElements(int count, int offset);
+void drainStream();
+void stopStream();
@@ -0,0 +1,201 @@
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "texture.h"
+
+using namespace std;
+
+// Identifies one version of a file: a replaced file or a rewrite changes it
+struct FileStamp {
+    dev_t device = 0;
+    ino_t inode = 0;
+    off_t size = 0;
+    int64_t mtime = 0;
+
+    bool operator==(const FileStamp &other) const
+    {
+        return device == other.device && inode == other.inode && size == other.size && mtime == other.mtime;
+    }
+};
+
+struct CacheEntry {
+    std::string path;           // canonical, so relative paths from different directories differ
+    FileStamp stamp;
+    uint64_t decodeId;
+    std::shared_future<std::shared_ptr<const Texture>> texture;
+    bool done = false;          // decode finished (or failed) and bytes counted
+    size_t bytes = 0;
+    bool prefetched = false;    // looked up by prefetchTexture, not yet acquired
+};
+
+static std::mutex cacheMutex;
+static std::list<CacheEntry> lru;   // front is the most recently used
+static std::unordered_map<std::string, std::list<CacheEntry>::iterator> entries;
+static size_t budget = TEXTURE_CACHE_BYTES;
+static TextureCacheStats stats;
+static uint64_t nextDecodeId = 0;
+
+
+static std::shared_ptr<const Texture> decode(const std::string &path)
+{
+    image_t *image = load_image(path.c_str());
+    if (!image)
+    {
+        std::cerr << "Error loading texture " << path << std::endl;
+        return nullptr;
+    }
+    std::shared_ptr<Texture> texture = std::make_shared<Texture>();
+    texture->width = image->width;
+    texture->height = image->height;
+    texture->texels.resize(layoutSize(LAYOUT_TILED, image->width, image->height));
+    for (uint32_t y = 0; y < image->height; ++y)
+        for (uint32_t x = 0; x < image->width; ++x)
+            texture->texels[layoutIndex(LAYOUT_TILED, image->width, x, y)] = image->rgba[(size_t)y * image->width + x];
+    free_image(image);
+    return texture;
+}
+
+// Absolute path without symlinks or dot segments; a missing file is only made absolute
+static std::string canonicalPath(const std::string &path)
+{
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved)) return resolved;
+    if (!path.empty() && path[0] == '/') return path;
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) return path;
+    return std::string(cwd) + "/" + path;
+}
+
+static bool fileStamp(const std::string &path, FileStamp &stamp)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    stamp.device = st.st_dev;
+    stamp.inode = st.st_ino;
+    stamp.size = st.st_size;
+    stamp.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+// Count the decoded size of an entry whose decode finished; caller holds cacheMutex
+static void collect(CacheEntry &entry, const std::shared_ptr<const Texture> &texture)
+{
+    if (entry.done) return;
+    entry.done = true;
+    entry.bytes = texture ? texture->bytes() : 0;
+    stats.bytes += entry.bytes;
+}
+
+// Collect every background decode that has finished, bound or not; caller holds cacheMutex
+static void collectFinished()
+{
+    for (CacheEntry &entry : lru)
+    {
+        if (entry.done) continue;
+        // Deferred decodes (missing files) report `deferred` until acquired
+        if (entry.texture.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+        collect(entry, entry.texture.get());
+    }
+}
+
+// Drop least recently used finished entries until the cache fits; caller holds cacheMutex
+static void evict()
+{
+    collectFinished();
+    auto it = lru.end();
+    while (stats.bytes > budget && it != lru.begin())
+    {
+        --it;
+        // Still decoding; a deferred decode (missing file) has not started and holds nothing
+        if (!it->done && it->texture.wait_for(std::chrono::seconds(0)) != std::future_status::deferred) continue;
+        stats.bytes -= it->bytes;
+        ++stats.evictions;
+        entries.erase(it->path);
+        it = lru.erase(it);
+    }
+}
+
+// Cached or newly started decode of a canonical path; caller holds cacheMutex.
+// A prefetch and the acquire that follows it count as one lookup.
+static std::list<CacheEntry>::iterator lookup(const std::string &path, bool prefetch)
+{
+    FileStamp stamp;
+    bool exists = fileStamp(path, stamp);
+    auto found = entries.find(path);
+    if (found != entries.end())
+    {
+        if (found->second->stamp == stamp)
+        {
+            CacheEntry &entry = *found->second;
+            if (prefetch || !entry.prefetched) ++stats.hits;
+            entry.prefetched = prefetch;
+            lru.splice(lru.begin(), lru, found->second);
+            return found->second;
+        }
+        // Changed on disk: decode again
+        stats.bytes -= found->second->bytes;
+        lru.erase(found->second);
+        entries.erase(found);
+    }
+
+    ++stats.misses;
+    CacheEntry entry;
+    entry.path = path;
+    entry.stamp = stamp;
+    entry.decodeId = nextDecodeId++;
+    entry.prefetched = prefetch;
+    if (exists) entry.texture = std::async(std::launch::async, decode, path).share();
+    else entry.texture = std::async(std::launch::deferred, decode, path).share();
+    lru.push_front(entry);
+    entries[path] = lru.begin();
+    return lru.begin();
+}
+
+
+void prefetchTexture(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    lookup(canonicalPath(path), true);
+    evict();
+}
+
+std::shared_ptr<const Texture> acquireTexture(const std::string &path)
+{
+    std::string key = canonicalPath(path);
+    std::shared_future<std::shared_ptr<const Texture>> pending;
+    uint64_t decodeId;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto entry = lookup(key, false);
+        pending = entry->texture;
+        decodeId = entry->decodeId;
+    }
+    std::shared_ptr<const Texture> texture = pending.get();
+
+    // Account for the decoded size unless a finished background decode already was
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto found = entries.find(key);
+    if (found != entries.end() && found->second->decodeId == decodeId) collect(*found->second, texture);
+    evict();
+    return texture;
+}
+
+void setTextureCacheBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    budget = bytes;
+    evict();
+}
+
+TextureCacheStats textureCacheStats()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return stats;
+}
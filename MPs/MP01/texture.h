@@ -0,0 +1,59 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "uselibpng.h"
+#include "layout.h"
+
+/*
+Decoded textures and a process-wide cache of them.
+
+A texture is decoded once per file version (canonical path, device, inode,
+size and mtime) and kept in LAYOUT_TILED order, so nearby texcoords sample
+nearby memory. The cache is an LRU bounded by
+decoded bytes; evicted textures stay alive while a draw still holds them.
+
+prefetchTexture() starts decoding on a background thread, so the parser can
+call it when it reads `texture` and only block in acquireTexture() at the
+draw that needs it.
+*/
+
+// Decoded bytes the cache keeps before evicting least recently used textures
+constexpr size_t TEXTURE_CACHE_BYTES = 256 << 20;
+
+struct Texture {
+    uint32_t width = 0, height = 0;
+    std::vector<pixel_t> texels;    // LAYOUT_TILED order
+
+    size_t bytes() const { return texels.size() * sizeof(pixel_t); }
+
+    // Nearest texel; texcoords wrap, (0, 0) is the top-left corner
+    const pixel_t &sample(float s, float t) const {
+        s -= std::floor(s);
+        t -= std::floor(t);
+        if (!(s >= 0 && t >= 0)) s = t = 0;     // NaN or infinite texcoords
+        uint32_t x = std::min((uint32_t)(s * width), width - 1);
+        uint32_t y = std::min((uint32_t)(t * height), height - 1);
+        return texels[layoutIndex(LAYOUT_TILED, width, x, y)];
+    }
+};
+
+struct TextureCacheStats {
+    uint64_t hits = 0;      // served without decoding (decoded or already decoding);
+                            // a prefetch and its acquire count once
+    uint64_t misses = 0;    // had to start a decode
+    uint64_t evictions = 0;
+    size_t bytes = 0;       // decoded bytes held
+};
+
+// Start decoding path in the background unless it is cached
+void prefetchTexture(const std::string &path);
+// Decoded texture for path, waiting for its decode; nullptr if it can't be read
+std::shared_ptr<const Texture> acquireTexture(const std::string &path);
+
+void setTextureCacheBudget(size_t bytes);
+TextureCacheStats textureCacheStats();
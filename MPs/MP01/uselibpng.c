@@ -13,6 +13,7 @@ extern "C"
 
 #include <png.h>
 #include <stdlib.h>
+#include <string.h>
 #include "uselibpng.h"
 
   image_t *load_image(const char *filename)
@@ -92,45 +93,91 @@ extern "C"
     return ans;
   }
 
+  static void linear_rows(void *ctx, uint32_t y, pixel_t *row)
+  {
+    image_t *img = (image_t *)ctx;
+    memcpy(row, &(img->rgba[img->width * y]), img->width * sizeof(pixel_t));
+  }
+
   void save_image(image_t *img, const char *filename)
   {
-    png_structp ps = NULL;
-    png_infop pi = NULL;
-    FILE *out = NULL;
+    save_image_rows(img->width, img->height, linear_rows, img, filename);
+  }
 
-    ps = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    if (!ps)
+  struct png_writer_s
+  {
+    png_structp ps;
+    png_infop pi;
+    FILE *out;
+  };
+
+  png_writer_t *open_png_writer(uint32_t width, uint32_t height, const char *filename)
+  {
+    png_writer_t *w = (png_writer_t *)calloc(1, sizeof(png_writer_t));
+    if (!w)
       goto fail1;
-    pi = png_create_info_struct(ps);
-    if (!pi)
+    w->ps = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!w->ps)
       goto fail2;
+    w->pi = png_create_info_struct(w->ps);
+    if (!w->pi)
+      goto fail3;
 
-    out = fopen(filename, "wb");
-    if (!out)
-      goto fail2;
-    png_init_io(ps, out);
+    w->out = fopen(filename, "wb");
+    if (!w->out)
+      goto fail3;
+    png_init_io(w->ps, w->out);
     // png_set_compression_level(ps, Z_BEST_COMPRESSION);
-    png_set_IHDR(ps, pi, img->width, img->height,
+    png_set_IHDR(w->ps, w->pi, width, height,
                  8, // bits per channel
                  PNG_COLOR_TYPE_RGB_ALPHA,
                  PNG_INTERLACE_NONE,
                  PNG_COMPRESSION_TYPE_DEFAULT,
                  PNG_FILTER_TYPE_DEFAULT);
-    png_write_info(ps, pi);
-    png_set_packing(ps);
-
-    for (uint32_t i = 0; i < img->height; i += 1)
-    {
-      png_write_row(ps, (png_byte *)&(img->rgba[img->width * i]));
-    }
+    png_write_info(w->ps, w->pi);
+    png_set_packing(w->ps);
+    return w;
 
-    png_write_end(ps, NULL);
-
-    fclose(out);
+  fail3:
+    png_destroy_write_struct(&w->ps, &w->pi);
   fail2:
-    png_destroy_write_struct(&ps, &pi);
+    free(w);
   fail1:
-    return;
+    return NULL;
+  }
+
+  void write_png_row(png_writer_t *w, const pixel_t *row)
+  {
+    png_write_row(w->ps, (png_const_bytep)row);
+  }
+
+  void close_png_writer(png_writer_t *w)
+  {
+    if (!w)
+      return;
+    png_write_end(w->ps, NULL);
+    fclose(w->out);
+    png_destroy_write_struct(&w->ps, &w->pi);
+    free(w);
+  }
+
+  void save_image_rows(uint32_t width, uint32_t height, row_source_t source, void *ctx, const char *filename)
+  {
+    png_writer_t *w = NULL;
+    pixel_t *row = (pixel_t *)malloc(width * sizeof(pixel_t));
+    if (!row)
+      return;
+    w = open_png_writer(width, height, filename);
+    if (w)
+    {
+      for (uint32_t i = 0; i < height; i += 1)
+      {
+        source(ctx, i, row);
+        write_png_row(w, row);
+      }
+      close_png_writer(w);
+    }
+    free(row);
   }
 
   image_t *new_image(uint32_t width, uint32_t height)
@@ -3,6 +3,7 @@
  * 
  * See uselibpng.c for implementation notes
  */
+#pragma once
 
 
 #ifdef __cplusplus
@@ -60,6 +61,41 @@ image_t *load_image(const char *filename);
  */
 void save_image(image_t *img, const char *filename);
 
+/**
+ * Supplies row y of an image being saved, as width pixels written to row.
+ */
+typedef void (*row_source_t)(void *ctx, uint32_t y, pixel_t *row);
+
+/**
+ * Save a PNG whose rows are produced on demand, one at a time, so the
+ * pixels never need to be stored row-major.
+ * 
+ * ~~~~
+ * save_image_rows(width, height, my_row_source, my_context, "new_image.png");
+ * ~~~~
+ */
+void save_image_rows(uint32_t width, uint32_t height, row_source_t source, void *ctx, const char *filename);
+
+/**
+ * A PNG file being written top to bottom, one row at a time, so the rows
+ * can be produced and dropped incrementally.
+ * 
+ * ~~~~
+ * png_writer_t *w = open_png_writer(width, height, "new_image.png");
+ * if (w == NULL) { fprintf(stderr, "could not create %s", "new_image.png"); }
+ * for(int y = 0; y < height; y += 1) write_png_row(w, my_row(y));
+ * close_png_writer(w);
+ * ~~~~
+ */
+typedef struct png_writer_s png_writer_t;
+
+png_writer_t *open_png_writer(uint32_t width, uint32_t height, const char *filename);
+
+/// Write the next row, width pixels; exactly height rows before closing
+void write_png_row(png_writer_t *w, const pixel_t *row);
+
+void close_png_writer(png_writer_t *w);
+
 /**
  * Allocate an image with the given width and height.
  * 